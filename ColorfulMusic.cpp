@@ -6,13 +6,30 @@
 //   date: fall 2014
 //   uses: RtAudio by Gary Scavone
 //-----------------------------------------------------------------------------
+// buffer object entry points from <GL/gl.h> (before anything includes it)
+#define GL_GLEXT_PROTOTYPES
 #include "RtAudio.h"
 #include "chuck_fft.h"
 #include <math.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 #include <iostream>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <new>
 #include "x-vector3d.h"
 #include "x-fun.h"
+#include "x-ring.h"
+#include "x-stft.h"
+#include "x-spectrogram.h"
+#include "x-pool.h"
+#include "x-offscreen.h"
+#include "x-wavfile.h"
+#include "x-synth.h"
+#include "x-profile.h"
 
 using namespace std;
 
@@ -34,10 +51,22 @@ using namespace std;
 //-----------------------------------------------------------------------------
 void help();
 void initGfx();
+void initGlState();
+void initAnalysis( unsigned int bufferFrames );
+int runHeadless( unsigned int bufferFrames );
+void drainCaptureRing();
+void feedSource();
+void stopFeeder();
+void quit();
+void initProfiler();
+void dumpProfile();
+void drawHud();
+void logStreamStats();
 void idleFunc();
 void displayFunc();
 void update(int);
-Vector3D getMixedRandomColor(Vector3D);
+void analyzeFrames();
+Vector3D getMixedRandomColor(Vector3D, XRandom & = XRandom::local());
 void reshapeFunc( GLsizei width, GLsizei height );
 void keyboardFunc( unsigned char, int, int );
 void specialKeyboardFunc(int, int, int );
@@ -49,7 +78,7 @@ void mouseFunc( int button, int state, int x, int y );
 #define MY_FORMAT RTAUDIO_FLOAT32
 // sample rate
 #define MY_SRATE 44100
-// number of channels
+// number of channels (default for --channels=)
 #define MY_CHANNELS 1
 // for convenience
 #define MY_PIE 3.14159265358979
@@ -57,6 +86,18 @@ void mouseFunc( int button, int state, int x, int y );
 #define GRAVITY 3.0
 #define TIMER_MS 25
 #define NUM_FREQ_SEGMENTS 14
+// distance between waterfall rows
+#define WATERFALL_ROW_DEPTH 0.4
+// number of audio blocks the capture ring can hold
+#define CAPTURE_RING_BLOCKS 64
+// default kaiser beta (--taper=kaiser): about -70 dB sidelobes
+#define KAISER_BETA 8.6f
+// spectrum compression gains, picked so typical input draws at similar
+// heights under every curve; the log curve starts at -60 dB
+#define SPECTRUM_SQRT_GAIN 30
+#define SPECTRUM_CBRT_GAIN 14
+#define SPECTRUM_LOG_GAIN 3
+#define SPECTRUM_LOG_FLOOR 1e-3
 
 #define AMPLITUDE_CHANGE_THRESHOLD 2
 #define PITCH_THRESHOLD 0.8
@@ -68,24 +109,98 @@ float NUM_PARTICLES = 1000;
 float PARTICLE_SIZE = 0.1;
 
 enum DISPLAY_MODE { WATER_FALL=0, WOBBLE=1, PARTICLES=2 };
+// what the waterfall shows: the mix, every input side by side, or mid
+// and side side by side (--view=, 'v')
+enum WATERFALL_VIEW { VIEW_MIX=0, VIEW_CHANNELS=1, VIEW_MIDSIDE=2, NUM_VIEWS=3 };
 
 // width and height
 long g_width = 1024;
 long g_height = 720;
 long g_last_width = g_width;
 long g_last_height = g_height;
-// global buffer
-SAMPLE * g_buffer = NULL;
-// fft buffer
-SAMPLE * g_fftBuf = NULL;
+// capture ring: written by callme(), drained by displayFunc()
+XBlockRing g_captureRing;
 long g_bufferSize;
-// window
-SAMPLE * g_window = NULL;
+// input channels captured and analyzed (--channels=)
+long g_numChannels = MY_CHANNELS;
+// stft between the capture ring and the history
+XStft g_stft;
+// fft size (history rows hold g_windowSize/2 bins)
 long g_windowSize;
-float ** g_fftBufs = NULL;
+// requested stft window, hop, fft size (0 = derive from buffer size)
+long g_stftWindow = 0;
+long g_stftHop = 0;
+long g_stftFft = 0;
+// stft window shape (--taper=) and kaiser beta
+int g_stftTaper = WINDOW_HANN;
+float g_stftBeta = KAISER_BETA;
+// waterfall history: HISTORY_SIZE rows of g_windowSize/2 bins, by age.
+// one channel for mono input; otherwise the mix (the mid signal, for
+// stereo), the side signal, then every input (see historyChannel())
+XSpectrogram g_history;
+#define HISTORY_MIX 0
+#define HISTORY_SIDE 1
+// mix and side spectra, computed per frame from the input spectra
+complex * g_mixSpectrum = NULL;
+complex * g_sideSpectrum = NULL;
+WATERFALL_VIEW g_waterfallView = VIEW_MIX;
+// magnitude curve for history rows (--curve=sqrt|cbrt|log)
+int g_spectrumCurve = SPECTRUM_SQRT;
+float g_spectrumGain = SPECTRUM_SQRT_GAIN;
 float ** g_simpleBufs = NULL;
 Vector3D g_color = Vector3D(0.5, 0.5, 1);
+// row colors, indexed by g_history.slot(age)
 Vector3D *g_colors = new Vector3D[HISTORY_SIZE];
+// headless mode (--headless=PATTERN): render offscreen on a fixed clock
+// and write every frame to PATTERN, formatted with the frame number
+const char * g_headlessPattern = NULL;
+double g_headlessFps = 30;
+// 0 = the length of the input (300 without one)
+long g_headlessFrames = 0;
+// keys applied before the first headless frame (e.g. "pc")
+const char * g_headlessKeys = "";
+// offline input (--input=FILE or --synth=SPEC) in place of the audio device
+XSource * g_source = NULL;
+// feeds g_source into the capture ring when there is a window;
+// stopFeeder() stops and joins it, however we exit
+std::thread g_feeder;
+std::atomic<bool> g_feederStop( false );
+// how fast the input is fed: as fast as analysis takes it, or in real
+// time (--pace=fast|realtime; default fast headless, real time otherwise)
+enum SOURCE_PACE { PACE_DEFAULT=0, PACE_FAST, PACE_REALTIME };
+SOURCE_PACE g_pace = PACE_DEFAULT;
+// sample rate of whatever feeds the capture ring
+unsigned long g_srate = MY_SRATE;
+
+// per-stage latency histograms; the HUD ('i') shows them, and
+// --profile=FILE (.csv or .json) dumps them on exit
+enum PROFILE_STAGE {
+  STAGE_CALLBACK = 0,   // audio callback
+  STAGE_FRAME_INTERVAL, // start of one displayFunc() to the next
+  STAGE_FRAME,          // all of displayFunc()
+  STAGE_DRAIN,          // capture ring -> stft
+  STAGE_FFT,            // batched stft transform
+  STAGE_HISTORY,        // pushFftBuf(), per frame
+  STAGE_AMPLITUDE,      // peak search and color, per frame
+  STAGE_STEP,           // particle simulation in update()
+  STAGE_SORT,           // particle tilt + depth sort
+  STAGE_PARTICLES_GL,   // particle draw calls
+  STAGE_WATERFALL_GL,   // waterfall upload + draw calls
+  STAGE_HUD,            // drawing this overlay
+  STAGE_SWAP,           // flush + buffer swap
+  NUM_STAGES
+};
+XProfiler g_profiler;
+bool g_showHud = false;
+const char * g_profilePath = NULL;
+// the audio device, once its stream is open (not with --input/--synth);
+// its xrun and callback overrun counts go on the HUD and to stderr
+RtAudio * g_audio = NULL;
+
+// audio api names for --api=, indexed by RtAudio::Api
+const char * g_apiNames[] = { "auto", "alsa", "oss", "jack", "core", "asio",
+                              "ds", "dummy" };
+#define NUM_APIS ((int)(sizeof(g_apiNames) / sizeof(g_apiNames[0])))
 
 // global variables
 GLboolean g_fullscreen = FALSE;
@@ -114,102 +229,188 @@ bool isAmplitudeHigh() {
 // Particle System
 //-----------------------------------------------------------------------------
 
-struct Particle {
-  Vector3D location;
-  Vector3D color;
-  float scale;
-  Vector3D rotation;
-  float rot_radius;
-  float rot_degrees;
-  Vector3D velocity;
-  float age; // The amount of time this particle has been alive
-  float lifespan; // Total amount of time this particle is to live.
+// particles are drawn tilted about the x axis by this much
+#define PARTICLE_TILT_DEGREES -30
+// depth keys are quantized to this many bits for the radix sort
+#define DEPTH_KEY_BITS 16
+
+// particle state is kept as a structure of arrays, one float array per
+// field, so step() streams through only the fields it touches and the
+// compiler can vectorize each loop
+enum PARTICLE_FIELD {
+  P_POS_X = 0, P_POS_Y, P_POS_Z,
+  P_VEL_X, P_VEL_Y, P_VEL_Z,
+  P_COLOR_R, P_COLOR_G, P_COLOR_B,
+  P_AGE,       // the amount of time this particle has been alive
+  P_LIFESPAN,  // total amount of time this particle is to live
+  P_SCALE,
+  P_ROT_RADIUS,
+  P_ROT_DEGREES,
+  // render scratch: tilted position, recomputed every frame
+  P_VIEW_X, P_VIEW_Y, P_VIEW_Z,
+  P_NUM_FIELDS
 };
 
-Vector3D rotate(Vector3D v, Vector3D axis, float degrees) {
-  axis.normalize();
-  float radians = degrees * MY_PIE / 180;
-  float s = sin(radians);
-  float c = cos(radians);
-  return v * c + axis * (axis * v) * (1 - c) + (v ^ axis) * s;
-}
+// field arrays start on 32-byte boundaries
+#define PARTICLE_ALIGN 32
+#define MAX_PARTICLES 204800
+// particles per work chunk (a multiple of the alignment); each chunk
+// owns a random stream so results don't depend on the thread count
+#define PARTICLE_CHUNK 4096
+#define PARTICLE_NUM_CHUNKS (MAX_PARTICLES / PARTICLE_CHUNK)
+#define PARTICLE_SEED 0x5eed
 
-Vector3D rotatedParticlePos(Vector3D pos) {
-  return rotate(pos, Vector3D(1, 0, 0), -30);
-}
+// random seed (--seed=N); the same seed gives the same particles
+uint64_t g_seed = PARTICLE_SEED;
+
+// workers for the particle simulation
+XWorkPool g_workPool;
 
-bool compareParticles(Particle *p1, Particle *p2) {
-  return rotatedParticlePos(p1->location).y < rotatedParticlePos(p2->location).y;
-}
-  
 class ParticleEngine {
   private:
-    Particle particles[20000];
+    // all fields in one aligned block, MAX_PARTICLES (padded) apart
+    float *storage;
+    long stride;
+    float *field[P_NUM_FIELDS];
+    // render scratch: depth keys and draw order (back to front)
+    unsigned int *depthKey;
+    int *order;
+    int *orderTmp;
+    // one random stream per chunk
+    XRandom chunkRandom[PARTICLE_NUM_CHUNKS];
+    // parameters of the step in flight, shared by all chunks
+    float stepSpin;
+    float stepGrow;
     float timeUntilNextStep;
     Vector3D color;
     int particleCounter;
     float particleRotation;
 
-    Vector3D currentVelocity() {
-      float angle = XFun::rand2f(0, 6.28);
+    Vector3D currentVelocity(XRandom &rng) {
+      float angle = rng.rand2f(0, 6.28);
       return Vector3D(2.0 * cos(angle), 2.0f, 2.0 * sin(angle));
     }
 
-    void createNewParticle(Particle *p) {
-      p->location = Vector3D(0, 0, 0);
-      p->velocity = currentVelocity() + Vector3D(XFun::rand2f(-0.2, 2), 
-                      XFun::rand2f(-0.2, 2), XFun::rand2f(-0.2, 2));
-      p->age = 0;
-      p->lifespan = XFun::rand2f(0, 2) + 1;
-      if (isColorful) 
-        p->color = getMixedRandomColor(g_color);
-      else 
-        p->color = g_color;
-      p->rot_radius = XFun::rand2f(0.1, g_maxAmp+2);
-      p->rot_degrees = XFun::rand2f(0, 6.28);
-      p->scale = PARTICLE_SIZE;
+    // may run on any worker; only touches particle i and its chunk's stream
+    void createNewParticle(int i) {
+      XRandom &rng = chunkRandom[i / PARTICLE_CHUNK];
+      Vector3D velocity = currentVelocity(rng) + Vector3D(rng.rand2f(-0.2, 2), 
+                      rng.rand2f(-0.2, 2), rng.rand2f(-0.2, 2));
+      Vector3D c = isColorful ? getMixedRandomColor(g_color, rng) : g_color;
+      field[P_POS_X][i] = field[P_POS_Y][i] = field[P_POS_Z][i] = 0;
+      field[P_VEL_X][i] = velocity.x;
+      field[P_VEL_Y][i] = velocity.y;
+      field[P_VEL_Z][i] = velocity.z;
+      field[P_AGE][i] = 0;
+      field[P_LIFESPAN][i] = rng.rand2f(0, 2) + 1;
+      field[P_COLOR_R][i] = c.x;
+      field[P_COLOR_G][i] = c.y;
+      field[P_COLOR_B][i] = c.z;
+      field[P_ROT_RADIUS][i] = rng.rand2f(0.1, g_maxAmp+2);
+      field[P_ROT_DEGREES][i] = rng.rand2f(0, 6.28);
+      field[P_SCALE][i] = PARTICLE_SIZE;
     }
 
-    void step() {
-      for (int i = 0; i < NUM_PARTICLES; i++) {
-        Particle *p = particles + i;
-
-        if (isSpiral) {
-          p->rot_degrees += 3 * sin(500*STEP_TIME) * ((1-p->age)/p->lifespan) * 5 * STEP_TIME;
-          if (isTornado) {
-            p->rot_radius += 2 * STEP_TIME;
-          } 
-          p->location.set(
-              p->rot_radius * cos(p->rot_degrees), 
-              p->location.y += 4 * STEP_TIME,
-              p->rot_radius * sin(p->rot_degrees)
-          );
-        } else {
-          p->location += p->velocity * STEP_TIME * 2;
-          /*
-          if (isAmplitudeChanged()) 
-            p->location += p->velocity * STEP_TIME * 3; 
-            */
-        }
+    static void stepChunk(long chunk, int worker, void *data) {
+      ((ParticleEngine *)data)->stepRange(chunk * PARTICLE_CHUNK,
+          min((long)NUM_PARTICLES, (chunk + 1) * PARTICLE_CHUNK));
+    }
 
-        //p->velocity += Vector3D(0, -GRAVITY * STEP_TIME, 0);
-        p->age += STEP_TIME;
-        if (p->age >= p->lifespan) createNewParticle(p);
+    void stepRange(long begin, long end) {
+      int n = end - begin;
+      if (n <= 0) return;
+
+      if (isSpiral) {
+        spiralParticles(field[P_POS_X] + begin, field[P_POS_Y] + begin,
+                        field[P_POS_Z] + begin, field[P_ROT_RADIUS] + begin,
+                        field[P_ROT_DEGREES] + begin, field[P_AGE] + begin,
+                        field[P_LIFESPAN] + begin,
+                        stepSpin, stepGrow, 4 * STEP_TIME, n);
+      } else {
+        moveParticles(field[P_POS_X] + begin, field[P_POS_Y] + begin,
+                      field[P_POS_Z] + begin, field[P_VEL_X] + begin,
+                      field[P_VEL_Y] + begin, field[P_VEL_Z] + begin,
+                      STEP_TIME * 2, n);
       }
+
+      ageParticles(field[P_AGE] + begin, STEP_TIME, n);
+      // respawn is rare per step; keep it out of the vector loops
+      const float *age = field[P_AGE];
+      const float *lifespan = field[P_LIFESPAN];
+      for (long i = begin; i < end; i++)
+        if (age[i] >= lifespan[i]) createNewParticle(i);
+    }
+
+    // the step kernels take restrict-qualified arrays so they vectorize
+    static void moveParticles(float * __restrict px, float * __restrict py,
+                              float * __restrict pz, const float * __restrict vx,
+                              const float * __restrict vy, const float * __restrict vz,
+                              float dt, int n) {
+      for (int i = 0; i < n; i++) {
+        px[i] += vx[i] * dt;
+        py[i] += vy[i] * dt;
+        pz[i] += vz[i] * dt;
+      }
+    }
+
+    static void spiralParticles(float * __restrict px, float * __restrict py,
+                                float * __restrict pz, float * __restrict radius,
+                                float * __restrict degrees, const float * __restrict age,
+                                const float * __restrict lifespan,
+                                float spin, float grow, float rise, int n) {
+      for (int i = 0; i < n; i++) {
+        degrees[i] += spin * ((1-age[i])/lifespan[i]);
+        radius[i] += grow;
+        py[i] += rise;
+      }
+      for (int i = 0; i < n; i++) {
+        px[i] = radius[i] * cos(degrees[i]);
+        pz[i] = radius[i] * sin(degrees[i]);
+      }
+    }
+
+    static void ageParticles(float * __restrict age, float dt, int n) {
+      for (int i = 0; i < n; i++)
+        age[i] += dt;
     }
+
   public:
     ParticleEngine() {
       timeUntilNextStep = 0;
       particleCounter = 0;
       particleRotation = 0.0;
-      for (int i = 0; i < NUM_PARTICLES; i++) {
-        createNewParticle(particles+i);
+      // pad each field to a multiple of the alignment
+      long perLine = PARTICLE_ALIGN / sizeof(float);
+      stride = (MAX_PARTICLES + perLine - 1) / perLine * perLine;
+      void *block = NULL;
+      // fail the way new would
+      if (posix_memalign(&block, PARTICLE_ALIGN, sizeof(float) * stride * P_NUM_FIELDS))
+        throw std::bad_alloc();
+      storage = (float *)block;
+      memset(storage, 0, sizeof(float) * stride * P_NUM_FIELDS);
+      for (int f = 0; f < P_NUM_FIELDS; f++)
+        field[f] = storage + f * stride;
+      for (int c = 0; c < PARTICLE_NUM_CHUNKS; c++)
+        chunkRandom[c].seed(XRandom::streamSeed(g_seed, XRANDOM_USER_STREAMS + c));
+      depthKey = new unsigned int[MAX_PARTICLES];
+      order = new int[MAX_PARTICLES];
+      orderTmp = new int[MAX_PARTICLES];
+
+      for (int i = 0; i < MAX_PARTICLES; i++) {
+        createNewParticle(i);
       }
       for (int i = 0; i < 1 / STEP_TIME; i++) {
         step();
       }
     }
 
+    ~ParticleEngine() {
+      free(storage);
+      delete [] depthKey;
+      delete [] order;
+      delete [] orderTmp;
+    }
+
     void changeColor(Vector3D newColor) {
       color.set(
           (newColor.x + color.x) / 2, 
@@ -218,6 +419,16 @@ class ParticleEngine {
         );
     }
 
+    // one STEP_TIME of simulation for the first NUM_PARTICLES particles
+    void step() {
+      int n = NUM_PARTICLES;
+      long numChunks = (n + PARTICLE_CHUNK - 1) / PARTICLE_CHUNK;
+
+      stepSpin = 3 * sin(500*STEP_TIME) * 5 * STEP_TIME;
+      stepGrow = isTornado ? 2 * STEP_TIME : 0;
+      g_workPool.run(numChunks, stepChunk, this);
+    }
+
     void advance(float dt) {
       while (dt > 0) {
         if (timeUntilNextStep < dt) {
@@ -232,31 +443,88 @@ class ParticleEngine {
       }
     }
 
+    // tilt every particle once (rotation about x) into the view arrays
+    static void tiltParticles(const float * __restrict py, const float * __restrict pz,
+                              float * __restrict vy, float * __restrict vz,
+                              float c, float s, int n) {
+      for (int i = 0; i < n; i++) {
+        vy[i] = py[i] * c + pz[i] * s;
+        vz[i] = pz[i] * c - py[i] * s;
+      }
+    }
+
+    // order particles by tilted y: quantize to DEPTH_KEY_BITS and run an
+    // LSD radix sort, 8 bits per pass, over preallocated scratch; O(n)
+    void sortByDepth(int n) {
+      const float *vy = field[P_VIEW_Y];
+      if (n <= 0) return;
+
+      float lo = vy[0], hi = vy[0];
+      for (int i = 1; i < n; i++) {
+        lo = min(lo, vy[i]);
+        hi = max(hi, vy[i]);
+      }
+      float range = hi - lo;
+      float quant = range > 0 ? ((1 << DEPTH_KEY_BITS) - 1) / range : 0;
+      for (int i = 0; i < n; i++) {
+        depthKey[i] = (unsigned int)((vy[i] - lo) * quant);
+        order[i] = i;
+      }
+
+      for (int shift = 0; shift < DEPTH_KEY_BITS; shift += 8) {
+        int count[257] = { 0 };
+        for (int i = 0; i < n; i++)
+          count[((depthKey[order[i]] >> shift) & 0xff) + 1]++;
+        for (int b = 0; b < 256; b++)
+          count[b+1] += count[b];
+        for (int i = 0; i < n; i++)
+          orderTmp[count[(depthKey[order[i]] >> shift) & 0xff]++] = order[i];
+        swap(order, orderTmp);
+      }
+    }
+
+    // render prep, no GL: tilt the first n particles and sort them
+    void prepare(int n) {
+      float radians = PARTICLE_TILT_DEGREES * MY_PIE / 180;
+      tiltParticles(field[P_POS_Y], field[P_POS_Z], field[P_VIEW_Y], field[P_VIEW_Z],
+                    cos(radians), sin(radians), n);
+      sortByDepth(n);
+    }
+
     void render() {
+      int n = NUM_PARTICLES;
       glTranslatef(0, -1.5, 0);
-      vector<Particle*> particleVector;
-      for (int i = 0; i < NUM_PARTICLES; i++) {
-        particleVector.push_back(particles + i);
+
+      {
+        XScopedTimer timer(g_profiler, STAGE_SORT);
+        prepare(n);
       }
-      sort(particleVector.begin(), particleVector.end(), compareParticles);
+      XScopedTimer timer(g_profiler, STAGE_PARTICLES_GL);
+      // x is unchanged by a rotation about the x axis
+      const float *vx = field[P_POS_X];
+      const float *vy = field[P_VIEW_Y];
+      const float *vz = field[P_VIEW_Z];
+
+      float sizeScale = 1;
+      if (isAmplitudeTrackingEnabled) sizeScale *= g_maxAmp;
+      if (isAmplitudeHighEnabled && isAmplitudeHigh()) sizeScale *= 2;
+
       glBegin(GL_QUADS);
-      for (int i = 0; i < particleVector.size(); i++) {
-        Particle *p = particleVector[i];
-        glColor4f(p->color.x, p->color.y, p->color.z, (1 - p->age/p->lifespan)+0.2);
+      for (int k = 0; k < n; k++) {
+        int i = order[k];
+        glColor4f(field[P_COLOR_R][i], field[P_COLOR_G][i], field[P_COLOR_B][i],
+                  (1 - field[P_AGE][i]/field[P_LIFESPAN][i])+0.2);
 
-        float size = p->scale;
-        if (isAmplitudeTrackingEnabled) size *= g_maxAmp;
-        if (isAmplitudeHighEnabled && isAmplitudeHigh()) size *= 2;
-        Vector3D pos = rotatedParticlePos(p->location);
+        float size = field[P_SCALE][i] * sizeScale;
 
         glTexCoord2f(0, 0);
-        glVertex3f(pos.x - size, pos.y - size, pos.z);
+        glVertex3f(vx[i] - size, vy[i] - size, vz[i]);
         glTexCoord2f(0, 1);
-        glVertex3f(pos.x - size, pos.y + size, pos.z);
+        glVertex3f(vx[i] - size, vy[i] + size, vz[i]);
         glTexCoord2f(1, 1);
-        glVertex3f(pos.x + size, pos.y + size, pos.z);
+        glVertex3f(vx[i] + size, vy[i] + size, vz[i]);
         glTexCoord2f(1, 0);
-        glVertex3f(pos.x + size, pos.y - size, pos.z);
+        glVertex3f(vx[i] + size, vy[i] - size, vz[i]);
       }
       glEnd();
     }
@@ -265,32 +533,203 @@ class ParticleEngine {
 ParticleEngine *g_particleEngine;
 
 
+// history channel holding an input's spectrum
+long historyChannel(long input) {
+  return g_numChannels == 1 ? HISTORY_MIX : input + 2;
+}
+
 void initializeFftBufs() {
-  g_fftBufs = new float*[HISTORY_SIZE];
-  for (int i = 0; i < HISTORY_SIZE; i++) {
-    g_fftBufs[i] = new float[g_bufferSize];
-    for (int j = 0; j < g_bufferSize; j++) {
-      g_fftBufs[i][j] = 0;
-    }
-  }
+  long bins = g_windowSize/2;
+  g_history.init(HISTORY_SIZE, bins, g_numChannels == 1 ? 1 : g_numChannels + 2);
+  delete [] g_mixSpectrum;
+  delete [] g_sideSpectrum;
+  g_mixSpectrum = new complex[bins];
+  g_sideSpectrum = new complex[bins];
 }
 
-void shiftRightFftBufs(complex* current) {
-  for (int i = HISTORY_SIZE-1; i > 0; i--) {
-    g_colors[i].set(g_colors[i-1].x, g_colors[i-1].y, g_colors[i-1].z);
-    memmove(&g_fftBufs[i][0], &g_fftBufs[i-1][0], g_bufferSize * sizeof(float));
+// push a new spectrum per input (channelStride complex values apart) as
+// the newest history row; O(bins * channels)
+void pushFftBuf(complex* current, unsigned long channelStride = 0) {
+  long bins = g_windowSize/2;
+  float * row = g_history.push();
+  unsigned long rowStride = g_history.channelStride();
+  g_colors[g_history.slot(0)].set(g_color.x, g_color.y, g_color.z);
+  // magnitude and compression in one vectorized pass
+  if (g_numChannels == 1) {
+    spectrum_compress(current, row, bins, g_spectrumCurve,
+                      g_spectrumGain, SPECTRUM_LOG_FLOOR);
+    return;
   }
-  float max = 0;
-  for (int i = 0; i < g_windowSize/2; i++) {
-    g_colors[0].set(g_color.x, g_color.y, g_color.z);
-    g_fftBufs[0][i] = 30 * pow(cmp_abs(current[i]),0.5);
+
+  // the fft is linear, so the mix and side spectra are sums of the input
+  // spectra: mix = mean of the inputs, side = (first - second) / 2
+  const complex * left = current;
+  const complex * right = current + channelStride;
+  for (long j = 0; j < bins; j++) {
+    g_mixSpectrum[j] = left[j];
+    g_sideSpectrum[j].re = (left[j].re - right[j].re) * 0.5f;
+    g_sideSpectrum[j].im = (left[j].im - right[j].im) * 0.5f;
   }
+  for (long c = 1; c < g_numChannels; c++) {
+    const complex * in = current + c * channelStride;
+    for (long j = 0; j < bins; j++) {
+      g_mixSpectrum[j].re += in[j].re;
+      g_mixSpectrum[j].im += in[j].im;
+    }
+  }
+  float scale = 1.0f / g_numChannels;
+  for (long j = 0; j < bins; j++) {
+    g_mixSpectrum[j].re *= scale;
+    g_mixSpectrum[j].im *= scale;
+  }
+
+  spectrum_compress(g_mixSpectrum, row + HISTORY_MIX * rowStride, bins,
+                    g_spectrumCurve, g_spectrumGain, SPECTRUM_LOG_FLOOR);
+  spectrum_compress(g_sideSpectrum, row + HISTORY_SIDE * rowStride, bins,
+                    g_spectrumCurve, g_spectrumGain, SPECTRUM_LOG_FLOOR);
+  for (long c = 0; c < g_numChannels; c++)
+    spectrum_compress(current + c * channelStride, row + historyChannel(c) * rowStride,
+                      bins, g_spectrumCurve, g_spectrumGain, SPECTRUM_LOG_FLOOR);
 }
 
-Vector3D getMixedRandomColor(Vector3D mixColor) {
-  float r = XFun::rand2f(0, 1);
-  float g = XFun::rand2f(0, 1);
-  float b = XFun::rand2f(0, 1);
+//-----------------------------------------------------------------------------
+// Waterfall renderer
+//
+// every history slot owns a fixed range of one vertex buffer (a line per
+// bin, bottom and top vertex).  only rows pushed since the last frame are
+// uploaded; the whole history is then drawn as two ranges, oldest first,
+// with the depth of each range set by a translation.  there is one
+// renderer per history channel.
+//-----------------------------------------------------------------------------
+
+struct WaterfallVertex {
+  GLfloat x, y, z;
+  GLfloat r, g, b, a;
+};
+
+class WaterfallRenderer {
+  private:
+    GLuint vbo;
+    long channel;
+    long rows;
+    long bins;
+    unsigned long long uploaded;
+    WaterfallVertex *scratch;
+
+    // slots are stored in reverse so ascending vertex order is oldest first
+    long bufferRow(long slot) {
+      return rows - 1 - slot;
+    }
+
+    void uploadRow(long age) {
+      long slot = g_history.slot(age);
+      long r = bufferRow(slot);
+      const float *row = g_history.row(age, channel);
+      Vector3D color = g_colors[slot];
+      GLfloat alpha = 0.7;
+      GLfloat x = -5;
+      GLfloat xinc = fabs(x*2 / bins);
+      GLfloat z = r * WATERFALL_ROW_DEPTH;
+
+      for (long j = 0; j < bins; j++) {
+        if (isColorful && j%50 == 0) {
+          color = getMixedRandomColor(g_colors[slot]);
+          alpha = 0.9;
+        }
+        x += xinc;
+        WaterfallVertex *v = scratch + 2*j;
+        v[0].x = v[1].x = x;
+        v[0].y = 0;
+        v[1].y = row[j];
+        v[0].z = v[1].z = z;
+        v[0].r = v[1].r = color.x;
+        v[0].g = v[1].g = color.y;
+        v[0].b = v[1].b = color.z;
+        v[0].a = v[1].a = alpha;
+      }
+
+      glBufferSubData(GL_ARRAY_BUFFER, r * bins * 2 * sizeof(WaterfallVertex),
+                      bins * 2 * sizeof(WaterfallVertex), scratch);
+    }
+
+    void drawRange(long firstRow, long numRows, GLfloat depth) {
+      if (numRows <= 0) return;
+      glPushMatrix();
+      glTranslatef(0, 0, depth);
+      glDrawArrays(GL_LINES, firstRow * bins * 2, numRows * bins * 2);
+      glPopMatrix();
+    }
+
+  public:
+    WaterfallRenderer() : vbo(0), channel(0), rows(0), bins(0), uploaded(0),
+                          scratch(NULL) { }
+
+    ~WaterfallRenderer() {
+      if (vbo) glDeleteBuffers(1, &vbo);
+      delete [] scratch;
+    }
+
+    // needs a GL context and an initialized g_history
+    void init(long historyChannel) {
+      channel = historyChannel;
+      rows = g_history.numRows();
+      bins = g_history.numBins();
+      scratch = new WaterfallVertex[bins * 2];
+      glGenBuffers(1, &vbo);
+      glBindBuffer(GL_ARRAY_BUFFER, vbo);
+      glBufferData(GL_ARRAY_BUFFER, rows * bins * 2 * sizeof(WaterfallVertex),
+                   NULL, GL_DYNAMIC_DRAW);
+      for (long age = 0; age < rows; age++)
+        uploadRow(age);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+      uploaded = g_history.pushes();
+    }
+
+    // xCenter and xScale place the (10 wide) waterfall across the view
+    void render(float amplitude, float xCenter = 0, float xScale = 1) {
+      XScopedTimer timer(g_profiler, STAGE_WATERFALL_GL);
+      glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+      // upload only what changed since the last frame
+      unsigned long long fresh = g_history.pushes() - uploaded;
+      if (fresh > (unsigned long long)rows) fresh = rows;
+      for (long age = 0; age < (long)fresh; age++)
+        uploadRow(age);
+      uploaded = g_history.pushes();
+
+      glLineWidth(3);
+      glPushMatrix();
+      glTranslatef(xCenter, -2, 0);
+      glScalef(xScale, amplitude, 1);
+      glEnableClientState(GL_VERTEX_ARRAY);
+      glEnableClientState(GL_COLOR_ARRAY);
+      glVertexPointer(3, GL_FLOAT, sizeof(WaterfallVertex), (GLvoid *)0);
+      glColorPointer(4, GL_FLOAT, sizeof(WaterfallVertex),
+                     (GLvoid *)(3 * sizeof(GLfloat)));
+
+      // age of slot s is (s - head) mod rows, drawn at z = 5 - age * depth
+      long head = g_history.head();
+      // slots [0, head): the oldest rows
+      drawRange(rows - head, head, 5 - (2*rows - 1 - head) * WATERFALL_ROW_DEPTH);
+      // slots [head, rows): the newest rows
+      drawRange(0, rows - head, 5 - (rows - 1 - head) * WATERFALL_ROW_DEPTH);
+
+      glDisableClientState(GL_COLOR_ARRAY);
+      glDisableClientState(GL_VERTEX_ARRAY);
+      glPopMatrix();
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
+
+// one per history channel
+WaterfallRenderer *g_waterfalls;
+
+Vector3D getMixedRandomColor(Vector3D mixColor, XRandom &rng) {
+  float rgb[3];
+  rng.fill(rgb, 3, 0, 1);
+  float r = rgb[0];
+  float g = rgb[1];
+  float b = rgb[2];
 
   r = 0.4 * r + 0.6 * mixColor.x;
   g = 0.4 * g + 0.6 * mixColor.y;
@@ -308,12 +747,14 @@ void computeAmplitudeAndFrequency() {
 
   SAMPLE maxAmp = -1;
   int maxIndex = -1;
-  for (int i = 0; i < g_windowSize; i++) {
-    if (g_fftBufs[0][i] > maxAmp) {
-      maxAmp = g_fftBufs[0][i];
+  // the mix stands for every input
+  const float * newest = g_history.row(0, HISTORY_MIX);
+  for (int i = 0; i < g_windowSize/2; i++) {
+    if (newest[i] > maxAmp) {
+      maxAmp = newest[i];
       maxIndex = i;
     }
-    if (g_fftBufs[0][i] > PITCH_THRESHOLD) {
+    if (newest[i] > PITCH_THRESHOLD) {
       g_maxFreqIndex = i;
     }
   }
@@ -358,14 +799,14 @@ int callme( void * outputBuffer, void * inputBuffer, unsigned int numFrames,
   SAMPLE * input = (SAMPLE *)inputBuffer;
   SAMPLE * output = (SAMPLE *)outputBuffer;
 
-  // fill
-  for( int i = 0; i < numFrames; i++ )
-  {
-    // assume mono
-    g_buffer[i] = input[i];
-    // zero output
-    output[i] = 0;
-  }
+  XScopedTimer timer( g_profiler, STAGE_CALLBACK );
+  // hand the block to the render thread (never blocks)
+  g_captureRing.push( input, numFrames );
+
+  // zero output (duplex only: --input-only streams have none)
+  if( output )
+    for( int i = 0; i < numFrames; i++ )
+      output[i] = 0;
 
   return 0;
 }
@@ -373,19 +814,219 @@ int callme( void * outputBuffer, void * inputBuffer, unsigned int numFrames,
 
 
 
+// the benchmark suite compiles this file with its own main()
+#ifndef __COLORFULMUSIC_BENCH__
 //-----------------------------------------------------------------------------
 // name: main()
 // desc: entry point
 //-----------------------------------------------------------------------------
 int main( int argc, char ** argv )
 {
-  // instantiate RtAudio object
-  RtAudio audio;
+  // audio api (--api=), opened once the options are in
+  RtAudio::Api api = RtAudio::UNSPECIFIED;
+  // extra stream flags (--mmap)
+  RtAudioStreamFlags streamFlags = 0;
+  // capture only, no output device (--input-only)
+  bool inputOnly = false;
   // variables
   unsigned int bufferBytes = 0;
   // frame size
   unsigned int bufferFrames = 1024;
 
+  // analysis and simulation options
+  int numThreads = 0;
+  const char * synthSpec = NULL;
+  double synthSeconds = 0;
+  for( int i = 1; i < argc; i++ )
+  {
+    if( !strncmp( argv[i], "--window=", 9 ) )
+      g_stftWindow = atol( argv[i] + 9 );
+    else if( !strncmp( argv[i], "--hop=", 6 ) )
+      g_stftHop = atol( argv[i] + 6 );
+    else if( !strncmp( argv[i], "--fft=", 6 ) )
+      g_stftFft = atol( argv[i] + 6 );
+    else if( !strncmp( argv[i], "--buffer=", 9 ) )
+    {
+      long frames = atol( argv[i] + 9 );
+      if( frames <= 0 )
+      {
+        cerr << "invalid buffer size: " << argv[i] + 9 << endl;
+        exit( 1 );
+      }
+      bufferFrames = frames;
+    }
+    else if( !strncmp( argv[i], "--api=", 6 ) )
+    {
+      std::vector<RtAudio::Api> compiled;
+      RtAudio::getCompiledApi( compiled );
+      int a = 0;
+      while( a < NUM_APIS && strcmp( argv[i] + 6, g_apiNames[a] ) ) a++;
+      if( a > 0 && a < NUM_APIS &&
+          std::find( compiled.begin(), compiled.end(), (RtAudio::Api)a ) == compiled.end() )
+        a = NUM_APIS;
+      if( a == NUM_APIS )
+      {
+        cout << "audio api not available: " << argv[i] + 6 << " (built with:";
+        for( size_t c = 0; c < compiled.size(); c++ )
+          cout << " " << g_apiNames[compiled[c]];
+        cout << ")" << endl;
+        exit( 1 );
+      }
+      api = (RtAudio::Api)a;
+    }
+    else if( !strcmp( argv[i], "--mmap" ) )
+      streamFlags |= RTAUDIO_ALSA_MMAP;
+    else if( !strcmp( argv[i], "--input-only" ) )
+      inputOnly = true;
+    else if( !strncmp( argv[i], "--channels=", 11 ) )
+    {
+      g_numChannels = atol( argv[i] + 11 );
+      if( g_numChannels <= 0 )
+      {
+        cerr << "invalid channel count: " << argv[i] + 11 << endl;
+        exit( 1 );
+      }
+    }
+    else if( !strcmp( argv[i], "--view=mix" ) )
+      g_waterfallView = VIEW_MIX;
+    else if( !strcmp( argv[i], "--view=channels" ) )
+      g_waterfallView = VIEW_CHANNELS;
+    else if( !strcmp( argv[i], "--view=midside" ) )
+      g_waterfallView = VIEW_MIDSIDE;
+    else if( !strncmp( argv[i], "--taper=", 8 ) )
+    {
+      const char * name = argv[i] + 8;
+      g_stftTaper = -1;
+      for( int w = WINDOW_HANN; w <= WINDOW_KAISER; w++ )
+      {
+        size_t len = strlen( window_name( w ) );
+        if( !strncmp( name, window_name( w ), len ) &&
+            ( name[len] == '\0' || (w == WINDOW_KAISER && name[len] == ':') ) )
+        {
+          g_stftTaper = w;
+          if( name[len] == ':' ) g_stftBeta = atof( name + len + 1 );
+        }
+      }
+      if( g_stftTaper < 0 )
+      {
+        cout << "unknown window: " << name << endl;
+        exit( 1 );
+      }
+    }
+    else if( !strncmp( argv[i], "--threads=", 10 ) )
+      numThreads = atoi( argv[i] + 10 );
+    else if( !strncmp( argv[i], "--particles=", 12 ) )
+      NUM_PARTICLES = max( 1, min( MAX_PARTICLES, atoi( argv[i] + 12 ) ) );
+    else if( !strncmp( argv[i], "--seed=", 7 ) )
+      g_seed = strtoull( argv[i] + 7, NULL, 0 );
+    else if( !strncmp( argv[i], "--headless=", 11 ) )
+      g_headlessPattern = argv[i] + 11;
+    else if( !strncmp( argv[i], "--size=", 7 ) )
+    {
+      long w = 0, h = 0;
+      char extra;
+      if( sscanf( argv[i] + 7, "%ldx%ld%c", &w, &h, &extra ) != 2 || w <= 0 || h <= 0 )
+      {
+        cerr << "invalid frame size: " << argv[i] + 7 << endl;
+        exit( 1 );
+      }
+      g_width = w;
+      g_height = h;
+    }
+    else if( !strncmp( argv[i], "--fps=", 6 ) )
+      g_headlessFps = atof( argv[i] + 6 );
+    else if( !strncmp( argv[i], "--frames=", 9 ) )
+      g_headlessFrames = atol( argv[i] + 9 );
+    else if( !strncmp( argv[i], "--keys=", 7 ) )
+      g_headlessKeys = argv[i] + 7;
+    else if( !strncmp( argv[i], "--synth=", 8 ) )
+      synthSpec = argv[i] + 8;
+    else if( !strncmp( argv[i], "--duration=", 11 ) )
+      synthSeconds = atof( argv[i] + 11 );
+    else if( !strncmp( argv[i], "--input=", 8 ) )
+    {
+      XWavFile * wav = new XWavFile();
+      if( !wav->open( argv[i] + 8 ) )
+      {
+        cout << "cannot read wav file: " << argv[i] + 8 << endl;
+        exit( 1 );
+      }
+      g_source = wav;
+    }
+    else if( !strcmp( argv[i], "--pace=fast" ) )
+      g_pace = PACE_FAST;
+    else if( !strcmp( argv[i], "--pace=realtime" ) )
+      g_pace = PACE_REALTIME;
+    else if( !strncmp( argv[i], "--profile=", 10 ) )
+      g_profilePath = argv[i] + 10;
+    else if( !strcmp( argv[i], "--curve=sqrt" ) )
+    {
+      g_spectrumCurve = SPECTRUM_SQRT;
+      g_spectrumGain = SPECTRUM_SQRT_GAIN;
+    }
+    else if( !strcmp( argv[i], "--curve=cbrt" ) )
+    {
+      g_spectrumCurve = SPECTRUM_CBRT;
+      g_spectrumGain = SPECTRUM_CBRT_GAIN;
+    }
+    else if( !strcmp( argv[i], "--curve=log" ) )
+    {
+      g_spectrumCurve = SPECTRUM_LOG10;
+      g_spectrumGain = SPECTRUM_LOG_GAIN;
+    }
+  }
+  if( synthSpec )
+  {
+    if( g_source )
+    {
+      cout << "use either --input or --synth" << endl;
+      exit( 1 );
+    }
+    // noise follows --seed, so runs are bit-reproducible
+    XSynth * synth = new XSynth();
+    if( !synth->init( synthSpec, MY_SRATE, synthSeconds, g_seed ) )
+    {
+      cout << "invalid synth spec: " << synthSpec << endl;
+      exit( 1 );
+    }
+    g_source = synth;
+  }
+  if( g_source )
+    g_srate = g_source->sampleRate();
+  // one seed drives every random stream
+  XFun::srand( g_seed );
+  // stage timers; dumped however we exit
+  initProfiler();
+  if( g_profilePath )
+    atexit( dumpProfile );
+  // simulation workers
+  g_workPool.init( numThreads );
+
+  // no window and no audio device
+  if( g_headlessPattern )
+    return runHeadless( bufferFrames );
+
+  // window, but the input stands in for the audio device
+  if( g_source )
+  {
+    glutInit( &argc, argv );
+    initGfx();
+    initAnalysis( bufferFrames );
+    help();
+    g_particleEngine = new ParticleEngine();
+    // the feeder plays the part of callme()
+    g_feeder = std::thread( feedSource );
+    // a joinable thread must not outlive exit() (closing the window, 'q')
+    atexit( stopFeeder );
+    glutTimerFunc(TIMER_MS, update, 0);
+    glutMainLoop();
+    return 0;
+  }
+
+  // instantiate RtAudio object; auto takes the first api with devices
+  RtAudio audio( api );
+  cerr << "audio api: " << g_apiNames[audio.getCurrentApi()] << endl;
+
   // check for audio devices
   if( audio.getDeviceCount() < 1 )
   {
@@ -396,6 +1037,7 @@ int main( int argc, char ** argv )
 
   // initialize GLUT
   glutInit( &argc, argv );
+
   // init gfx
   initGfx();
 
@@ -405,7 +1047,7 @@ int main( int argc, char ** argv )
   // set input and output parameters
   RtAudio::StreamParameters iParams, oParams;
   iParams.deviceId = audio.getDefaultInputDevice();
-  iParams.nChannels = MY_CHANNELS;
+  iParams.nChannels = g_numChannels;
   iParams.firstChannel = 0;
   oParams.deviceId = audio.getDefaultOutputDevice();
   oParams.nChannels = MY_CHANNELS;
@@ -413,11 +1055,14 @@ int main( int argc, char ** argv )
 
   // create stream options
   RtAudio::StreamOptions options;
+  options.flags |= streamFlags;
 
   // go for it
   try {
     // open a stream
-    audio.openStream( &oParams, &iParams, MY_FORMAT, MY_SRATE, &bufferFrames, &callme, (void *)&bufferBytes, &options );
+    // the output is only ever silence; --input-only leaves it closed
+    audio.openStream( inputOnly ? NULL : &oParams, &iParams, MY_FORMAT, MY_SRATE,
+                      &bufferFrames, &callme, (void *)&bufferBytes, &options );
   }
   catch( RtError& e )
   {
@@ -425,22 +1070,14 @@ int main( int argc, char ** argv )
     cout << e.getMessage() << endl;
     exit( 1 );
   }
+  g_audio = &audio;
+  // the totals so far, however we exit (main's frame outlives exit())
+  atexit( logStreamStats );
 
   // compute
-  bufferBytes = bufferFrames * MY_CHANNELS * sizeof(SAMPLE);
-  // allocate global buffer
-  g_bufferSize = bufferFrames;
-  initializeFftBufs();
-  g_buffer = new SAMPLE[g_bufferSize];
-  g_fftBuf = new SAMPLE[g_bufferSize];
-  memset( g_buffer, 0, sizeof(SAMPLE)*g_bufferSize );
-  memset( g_fftBuf, 0, sizeof(SAMPLE)*g_bufferSize );
-
-  // allocate buffer to hold window
-  g_windowSize = bufferFrames;
-  g_window = new SAMPLE[g_windowSize];
-  // generate the window
-  hanning( g_window, g_windowSize );
+  bufferBytes = bufferFrames * g_numChannels * sizeof(SAMPLE);
+  // capture ring, stft, history, waterfall
+  initAnalysis( bufferFrames );
 
   // print help
   help();
@@ -470,9 +1107,340 @@ cleanup:
   if( audio.isStreamOpen() )
     audio.closeStream();
 
+  // the final totals now: returning destroys audio before the atexit
+  // handler runs
+  logStreamStats();
+  g_audio = NULL;
+
   // done
   return 0;
 }
+#endif
+
+
+//-----------------------------------------------------------------------------
+// name: initAnalysis()
+// desc: capture ring, stft, history and waterfall for a given block size;
+//       needs a current GL context
+//-----------------------------------------------------------------------------
+void initAnalysis( unsigned int bufferFrames )
+{
+  // allocate global buffer
+  g_bufferSize = bufferFrames;
+  g_captureRing.init( CAPTURE_RING_BLOCKS, g_bufferSize, g_numChannels );
+
+  // stft: by default one un-overlapped window per audio buffer
+  long stftWindow = g_stftWindow > 0 ? g_stftWindow : bufferFrames;
+  long stftHop = g_stftHop > 0 ? g_stftHop : stftWindow;
+  long stftFft = g_stftFft;
+  if( stftFft <= 0 )
+    for( stftFft = 2; stftFft < stftWindow; stftFft <<= 1 );
+  // enough room for a full capture ring between redraws
+  long stftFrames = CAPTURE_RING_BLOCKS * bufferFrames / stftHop + 1;
+  if( !g_stft.init( stftWindow, stftHop, stftFft, stftFrames, g_stftTaper,
+                    g_stftBeta, g_numChannels ) )
+  {
+    cout << "invalid stft window/hop/fft: " << stftWindow << "/"
+         << stftHop << "/" << stftFft << endl;
+    exit( 1 );
+  }
+  g_windowSize = stftFft;
+  initializeFftBufs();
+  g_waterfalls = new WaterfallRenderer[g_history.numChannels()];
+  for( long c = 0; c < (long)g_history.numChannels(); c++ )
+    g_waterfalls[c].init( c );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: initProfiler()
+// desc: register the stages in PROFILE_STAGE order
+//-----------------------------------------------------------------------------
+void initProfiler()
+{
+  static const char * names[NUM_STAGES] = {
+    "callback", "frame interval", "frame", "drain", "fft", "history",
+    "amplitude", "step", "sort", "particles gl", "waterfall gl", "hud", "swap"
+  };
+  for( int s = 0; s < NUM_STAGES; s++ )
+    g_profiler.add( names[s] );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: dumpProfile()
+// desc: atexit handler for --profile
+//-----------------------------------------------------------------------------
+void dumpProfile()
+{
+  if( !g_profiler.write( g_profilePath ) )
+    cerr << "cannot write " << g_profilePath << endl;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: logStreamStats()
+// desc: the stream's xrun and overrun totals to stderr, if any changed
+//       since the last call
+//-----------------------------------------------------------------------------
+void logStreamStats()
+{
+  static unsigned long last = 0;
+  if( !g_audio ) return;
+
+  RtAudio::StreamStats stats = g_audio->getStreamStats();
+  unsigned long drops = stats.inputOverflows + stats.outputUnderflows + stats.callbackOverruns;
+  if( drops == last ) return;
+  last = drops;
+
+  // the slowest callbacks: the highest non-empty histogram bucket
+  int top = RTAUDIO_STATS_BUCKETS - 1;
+  while( top > 0 && !stats.callbackHistogram[top] ) top--;
+  char line[256];
+  snprintf( line, sizeof(line), "[audio] xruns: %lu in, %lu out; callback overruns: "
+            "%lu of %lu (period %.0f us, max %.0f us, %lu at %d+ us)",
+            stats.inputOverflows, stats.outputUnderflows, stats.callbackOverruns,
+            stats.callbacks, stats.periodSeconds * 1e6, stats.callbackMaxSeconds * 1e6,
+            stats.callbackHistogram[top], top ? 1 << top : 0 );
+  cerr << line << endl;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: drawHud()
+// desc: stage latency table in the top left corner, in window pixels
+//-----------------------------------------------------------------------------
+void drawHud()
+{
+  glMatrixMode( GL_PROJECTION );
+  glPushMatrix();
+  glLoadIdentity();
+  gluOrtho2D( 0, g_width, 0, g_height );
+  glMatrixMode( GL_MODELVIEW );
+  glPushMatrix();
+  glLoadIdentity();
+  glPushAttrib( GL_ENABLE_BIT | GL_CURRENT_BIT );
+  glDisable( GL_DEPTH_TEST );
+  glDisable( GL_LIGHTING );
+  glColor4f( 1, 1, 1, 0.9 );
+
+  char line[128];
+  for( int s = -1; s < g_profiler.numStages(); s++ )
+  {
+    if( s < 0 )
+      snprintf( line, sizeof(line), "%-15s %9s %9s %9s %9s", "stage (us)",
+                "count", "p50", "p99", "max" );
+    else
+      snprintf( line, sizeof(line), "%-15s %9llu %9.1f %9.1f %9.1f",
+                g_profiler.name( s ), (unsigned long long)g_profiler.count( s ),
+                g_profiler.percentile( s, 50 ) / 1000,
+                g_profiler.percentile( s, 99 ) / 1000,
+                g_profiler.max( s ) / 1000.0 );
+    glRasterPos2i( 10, g_height - 20 - 15 * (s + 1) );
+    for( const char * c = line; *c; c++ )
+      glutBitmapCharacter( GLUT_BITMAP_9_BY_15, *c );
+  }
+
+  // dropouts, under the table
+  if( g_audio )
+  {
+    RtAudio::StreamStats stats = g_audio->getStreamStats();
+    snprintf( line, sizeof(line), "xruns in/out %lu/%lu, callbacks over %.0f us %lu/%lu",
+              stats.inputOverflows, stats.outputUnderflows, stats.periodSeconds * 1e6,
+              stats.callbackOverruns, stats.callbacks );
+    glRasterPos2i( 10, g_height - 20 - 15 * (g_profiler.numStages() + 2) );
+    for( const char * c = line; *c; c++ )
+      glutBitmapCharacter( GLUT_BITMAP_9_BY_15, *c );
+  }
+
+  glPopAttrib();
+  glPopMatrix();
+  glMatrixMode( GL_PROJECTION );
+  glPopMatrix();
+  glMatrixMode( GL_MODELVIEW );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: feedSource()
+// desc: producer thread for --input with a window: push the input into the
+//       capture ring block by block, waiting for room instead of dropping,
+//       and (unless --pace=fast) no faster than real time
+//-----------------------------------------------------------------------------
+void feedSource()
+{
+  SAMPLE * block = new SAMPLE[g_bufferSize * g_numChannels];
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  unsigned long long fed = 0;
+
+  while( !g_feederStop.load() &&
+         ( !g_source->length() || g_source->position() < g_source->length() ) )
+  {
+    if( g_captureRing.space() == 0 )
+    {
+      std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+      continue;
+    }
+    g_source->read( block, g_bufferSize, g_numChannels );
+    g_captureRing.push( block, g_bufferSize );
+    fed += g_bufferSize;
+
+    if( g_pace != PACE_FAST )
+      std::this_thread::sleep_until( start +
+        std::chrono::microseconds( fed * 1000000 / g_srate ) );
+  }
+
+  if( !g_feederStop.load() )
+    cerr << "end of input" << endl;
+  delete [] block;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: quit()
+// desc: stop the audio stream and the feeder, the threads that push into
+//       the capture ring and read the input, then exit; exit() runs the
+//       static destructors of what they touch
+//-----------------------------------------------------------------------------
+void quit()
+{
+  if( g_audio && g_audio->isStreamOpen() )
+  {
+    try {
+      if( g_audio->isStreamRunning() )
+        g_audio->stopStream();
+    }
+    catch( RtError & e )
+    {
+      cerr << e.getMessage() << endl;
+    }
+    g_audio->closeStream();
+  }
+
+  stopFeeder();
+  exit( 0 );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: stopFeeder()
+// desc: stop and join the feeder thread, if there is one (also the
+//       atexit handler: freeglut exits when the window closes)
+//-----------------------------------------------------------------------------
+void stopFeeder()
+{
+  if( g_feeder.joinable() )
+  {
+    g_feederStop = true;
+    g_feeder.join();
+  }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: runHeadless()
+// desc: render g_headlessFrames frames offscreen at g_headlessFps, feeding
+//       the capture ring exactly the audio each frame covers, and write
+//       each frame to disk (.png by extension, raw RGBA otherwise);
+//       bufferFrames sizes the analysis as --buffer= does for a device
+//-----------------------------------------------------------------------------
+int runHeadless( unsigned int bufferFrames )
+{
+  XOffscreen target;
+  if( g_headlessFps <= 0 || !target.init( g_width, g_height ) )
+  {
+    cout << "cannot render offscreen at " << g_width << "x" << g_height
+         << " and " << g_headlessFps << " fps" << endl;
+    return 1;
+  }
+  initGlState();
+  reshapeFunc( g_width, g_height );
+  initAnalysis( bufferFrames );
+  g_particleEngine = new ParticleEngine();
+  for( const char * k = g_headlessKeys; *k; k++ )
+    keyboardFunc( *k, 0, 0 );
+
+  // by default, render the whole input
+  long numFrames = g_headlessFrames;
+  if( numFrames <= 0 )
+    numFrames = g_source && g_source->length()
+      ? (long)ceil( g_source->length() * g_headlessFps / g_srate ) : 300;
+
+  size_t len = strlen( g_headlessPattern );
+  bool png = len >= 4 && !strcmp( g_headlessPattern + len - 4, ".png" );
+  unsigned char * rgba = new unsigned char[g_width * g_height * 4];
+  SAMPLE * block = new SAMPLE[g_bufferSize * g_numChannels];
+  char path[1024];
+  long long fed = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  for( long f = 0; f < numFrames; f++ )
+  {
+    // audio that has arrived by the end of this frame
+    long long due = (long long)((f + 1) * g_srate / g_headlessFps);
+    while( fed < due )
+    {
+      // fed < due, so the difference is positive
+      unsigned long n = g_bufferSize;
+      if( n > (unsigned long long)(due - fed) ) n = due - fed;
+      // a frame may span more audio than the ring holds
+      if( g_captureRing.available() == g_captureRing.capacity() )
+      {
+        drainCaptureRing();
+        analyzeFrames();
+      }
+      // silence without an input
+      if( g_source ) g_source->read( block, n, g_numChannels );
+      g_captureRing.push( g_source ? block : NULL, n );
+      fed += n;
+    }
+
+    // the simulation advances by exactly one frame
+    if( g_displayMode == PARTICLES )
+    {
+      XScopedTimer timer( g_profiler, STAGE_STEP );
+      g_particleEngine->advance( 1.0f / g_headlessFps );
+    }
+    displayFunc();
+
+    target.read( rgba );
+    snprintf( path, sizeof(path), g_headlessPattern, f );
+    bool ok = png ? XOffscreen::writePng( path, rgba, g_width, g_height )
+                  : XOffscreen::writeRgba( path, rgba, g_width, g_height );
+    if( !ok )
+    {
+      cout << "cannot write " << path << endl;
+      delete [] rgba;
+      delete [] block;
+      return 1;
+    }
+
+    // previews: hold each frame until its time comes
+    if( g_pace == PACE_REALTIME )
+      std::this_thread::sleep_until( start +
+        std::chrono::microseconds( (long long)((f + 1) * 1000000 / g_headlessFps) ) );
+  }
+
+  delete [] rgba;
+  delete [] block;
+  return 0;
+}
 
 
 //-----------------------------------------------------------------------------
@@ -502,7 +1470,17 @@ void initGfx()
   // set the mouse function - called on mouse stuff
   glutMouseFunc( mouseFunc );
 
+  // rendering state
+  initGlState();
+}
+
 
+//-----------------------------------------------------------------------------
+// Name: initGlState( )
+// Desc: GL state shared by the window and headless modes
+//-----------------------------------------------------------------------------
+void initGlState()
+{
   // set clear color
   glClearColor( 0, 0, 0, 1 );
 
@@ -565,6 +1543,8 @@ void help()
   cerr << "'t' - toggle particles spiral tornado mode" << endl;
   cerr << "'a' - toggle high amplitude detection" << endl;
   cerr << "'z' - toggle amplitude tracking" << endl;
+  cerr << "'i' - toggle stage timing overlay" << endl;
+  cerr << "'v' - cycle waterfall view (mix, channels, mid/side)" << endl;
 
   cerr << "',' - make particles smaller" << endl;
   cerr << "'.' - make particles bigger" << endl;
@@ -573,6 +1553,42 @@ void help()
   cerr << "'ARROW_LEFT' - make less particles" << endl;
   cerr << "'ARROW_RIGHT' - make more particles" << endl;
   cerr << "----------------------------------------------------" << endl;
+  cerr << "OPTIONS" << endl;
+  cerr << "--buffer=N - frames per audio callback (default: 1024)" << endl;
+  cerr << "--window=N - analysis window length (default: buffer size)" << endl;
+  cerr << "--hop=N - samples between analysis frames (default: window)" << endl;
+  cerr << "--fft=N - zero-padded fft size, power of 2 (default: window)" << endl;
+  cerr << "--api=NAME - audio api, one of auto";
+  std::vector<RtAudio::Api> compiled;
+  RtAudio::getCompiledApi( compiled );
+  for( size_t c = 0; c < compiled.size(); c++ )
+    cerr << "|" << g_apiNames[compiled[c]];
+  cerr << " (default: auto)" << endl;
+  cerr << "--mmap - alsa: capture straight from the device's mmap'd buffer" << endl;
+  cerr << "--input-only - open the input device only (no silent output)" << endl;
+  cerr << "--channels=N - input channels to capture and analyze (default: 1)" << endl;
+  cerr << "--view=mix|channels|midside - waterfall view (default: mix)" << endl;
+  cerr << "--taper=hann|hamming|blackman|blackman-harris|kaiser[:BETA]" << endl;
+  cerr << "    - analysis window shape (default: hann; kaiser beta 8.6)" << endl;
+  cerr << "--threads=N - simulation and analysis threads (default: one per core)" << endl;
+  cerr << "--particles=N - initial particle count (default: 1000)" << endl;
+  cerr << "--seed=N - random seed; runs with the same seed repeat exactly" << endl;
+  cerr << "--headless=PATTERN - no window/audio; write frames to PATTERN" << endl;
+  cerr << "    (printf-style, e.g. out/%05d.png; other extensions: raw RGBA)" << endl;
+  cerr << "--size=WxH - frame size (default: 1024x720)" << endl;
+  cerr << "--fps=N - headless frame rate (default: 30)" << endl;
+  cerr << "--frames=N - headless frame count (default: whole input, or 300)" << endl;
+  cerr << "--keys=KEYS - headless: keys to apply first, e.g. --keys=pc" << endl;
+  cerr << "--input=FILE - analyze a WAV file instead of the audio device" << endl;
+  cerr << "--pace=fast|realtime - feed the input as fast as possible or in" << endl;
+  cerr << "    real time (default: fast when headless, else real time)" << endl;
+  cerr << "--synth=SPEC - built-in test signal instead of the audio device:" << endl;
+  cerr << "    sine:F, chord:F,F,... (up to 16 tones), chirp:FROM:TO:SECONDS, white, pink," << endl;
+  cerr << "    impulse:PER_SECOND" << endl;
+  cerr << "--duration=S - length of the --synth signal (default: endless)" << endl;
+  cerr << "--profile=FILE - write stage timings on exit (.csv or .json)" << endl;
+  cerr << "--curve=sqrt|cbrt|log - spectrum magnitude curve (default: sqrt)" << endl;
+  cerr << "----------------------------------------------------" << endl;
 }
 
 
@@ -586,7 +1602,7 @@ void specialKeyboardFunc(int key, int x, int y) {
       STEP_TIME /= 2;
       break;
     case GLUT_KEY_RIGHT:
-      if (NUM_PARTICLES <= 10000) 
+      if (NUM_PARTICLES * 2 <= MAX_PARTICLES) 
         NUM_PARTICLES *= 2;
       break;
     case GLUT_KEY_LEFT:
@@ -607,7 +1623,7 @@ void keyboardFunc( unsigned char key, int x, int y )
   switch( key )
   {
     case 'q': // quit
-      exit(1);
+      quit();
       break;
 
     case 'h': // print help
@@ -621,9 +1637,9 @@ void keyboardFunc( unsigned char key, int x, int y )
         {
           g_last_width = g_width;
           g_last_height = g_height;
-          glutFullScreen();
+          if( !g_headlessPattern ) glutFullScreen();
         }
-        else
+        else if( !g_headlessPattern )
           glutReshapeWindow( g_last_width, g_last_height );
 
         // toggle variable value
@@ -673,10 +1689,17 @@ void keyboardFunc( unsigned char key, int x, int y )
       isBothEnabled = !isBothEnabled;
       NUM_PARTICLES = 100;
       break;
+    case 'i':
+      g_showHud = !g_showHud;
+      break;
+    case 'v':
+      g_waterfallView = (WATERFALL_VIEW)((g_waterfallView + 1) % NUM_VIEWS);
+      break;
   }
 
   // trigger redraw
-  glutPostRedisplay( );
+  if( !g_headlessPattern )
+    glutPostRedisplay( );
 }
 
 
@@ -730,57 +1753,77 @@ void idleFunc( )
 
 void drawWaterFallMode()
 {
-  // define a starting point
-  GLfloat x = -5;
-  // compute increment
-  GLfloat xinc = ::fabs(x*2 / g_bufferSize);
-  xinc = fabs(x*2 / (g_windowSize / 2));
-  glLineWidth(3);
-
-
-  for (int i = HISTORY_SIZE-1; i >= 0; i--) {
-    glColor4f(g_colors[i].x, g_colors[i].y, g_colors[i].z, 0.7);
-    x = -5;
-    // save transformation state
-    glPushMatrix();
-    // translate
-    glTranslatef( 0, -2, 0 );
-    // start primitive
-    // loop over buffer to draw spectrum
-    for( int j = 0; j < g_windowSize/2; j++ )
+  // plot the magnitudes, with scaling
+  float amplitude = 1.0;
+  if (isAmplitudeTrackingEnabled)
+    amplitude *= g_maxAmp;
+  if (isAmplitudeHighEnabled && isAmplitudeHigh())
+    amplitude *= 1.4;
+
+  // history channels side by side; mono only has the mix
+  WATERFALL_VIEW view = g_numChannels > 1 ? g_waterfallView : VIEW_MIX;
+  long numPanels = view == VIEW_CHANNELS ? g_numChannels : view == VIEW_MIDSIDE ? 2 : 1;
+  float width = 10.0f / numPanels;
+  for (long p = 0; p < numPanels; p++) {
+    long channel = view == VIEW_CHANNELS ? historyChannel(p)
+                 : view == VIEW_MIDSIDE ? (p ? HISTORY_SIDE : HISTORY_MIX) : HISTORY_MIX;
+    g_waterfalls[channel].render(amplitude, -5 + (p + 0.5f) * width, 1.0f / numPanels);
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Name: analyzeFrames( )
+// Desc: FFT every queued stft frame in one batch per channel (the
+//       channels spread over the work pool) and push them into the
+//       history, oldest first
+//-----------------------------------------------------------------------------
+void analyzeFrames()
+{
+  // take forward FFT of all frames at once (time domain -> frequency domain)
+  unsigned long count;
+  {
+    XScopedTimer timer(g_profiler, STAGE_FFT);
+    count = g_stft.transform(&g_workPool);
+  }
+  for (unsigned long f = 0; f < count; f++) {
     {
-      
-      if (isColorful && j%50 == 0)  {
-        Vector3D lineColor = getMixedRandomColor(g_colors[i]);
-        glColor4f(lineColor.x, lineColor.y, lineColor.z, 0.9);
-      }
-      x += xinc;
-      glPushMatrix();
-      glBegin(GL_LINES);
-      // plot the magnitude,
-      // with scaling, and also "compression" via pow(...)
-      GLfloat z = 5 - i * 0.4;
-      glVertex3f( x, 0, z);
-      float amplitude = 1.0;
-      if (isAmplitudeTrackingEnabled)
-        amplitude *= g_maxAmp;
-      if (isAmplitudeHighEnabled && isAmplitudeHigh())
-        glVertex3f( x, 1.4 * g_fftBufs[i][j] * amplitude, z);
-      else 
-        glVertex3f( x, g_fftBufs[i][j] * amplitude, z);
-      glEnd();
-      // increment x
-      glPopMatrix();
+      XScopedTimer timer(g_profiler, STAGE_HISTORY);
+      pushFftBuf(g_stft.frame(f), g_stft.channelStride());
     }
+    XScopedTimer timer(g_profiler, STAGE_AMPLITUDE);
+    computeAmplitudeAndFrequency();
+    Vector3D newColor = getFreqColor();
+    g_color.set(newColor.x, newColor.y, newColor.z);
+  }
+  g_stft.clear();
+}
 
-    // end primitive
-    // restore transformations
-    glPopMatrix();
+//-----------------------------------------------------------------------------
+// Name: drainCaptureRing( )
+// Desc: feed every block waiting in the capture ring through the stft
+//-----------------------------------------------------------------------------
+void drainCaptureRing()
+{
+  XScopedTimer timer( g_profiler, STAGE_DRAIN );
+  const SAMPLE * block;
+  unsigned long numFrames;
+  while( (block = g_captureRing.peek(&numFrames)) != NULL )
+  {
+    g_stft.feed(block, numFrames);
+    g_captureRing.release();
   }
 }
 
 void update(int value) {
+  // report new xruns about once a second
+  static uint64_t lastLog = XProfiler::now();
+  if( XProfiler::now() - lastLog >= 1000000000ULL )
+  {
+    logStreamStats();
+    lastLog = XProfiler::now();
+  }
   if (g_displayMode == PARTICLES) {
+    XScopedTimer timer(g_profiler, STAGE_STEP);
     g_particleEngine->advance(TIMER_MS / 1000.0f);
     glutPostRedisplay();
   }
@@ -805,23 +1848,19 @@ void displayFunc( )
 {
   // local state
   static GLfloat zrot = 0.0f, c = 0.0f;
+  static uint64_t lastStart = 0;
+  uint64_t start = XProfiler::now();
+  if( lastStart ) g_profiler.record( STAGE_FRAME_INTERVAL, start - lastStart );
+  lastStart = start;
 
   // clear the color and depth buffers
   glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
 
 
-  // copy into the fft buf
-  memcpy(g_fftBuf, g_buffer, sizeof(SAMPLE)*g_bufferSize);
-  // apply window to buf
-  apply_window(g_fftBuf, g_window, g_windowSize);
-  // take forward FFT (time domain signal -> frequency domain signal)
-  rfft(g_fftBuf, g_windowSize/2, FFT_FORWARD);
-  // cast the result to a buffer of complex values (re,im)
-  complex *cbuf = (complex *)g_fftBuf;
-  shiftRightFftBufs(cbuf);
-  computeAmplitudeAndFrequency();
-  Vector3D newColor = getFreqColor();
-  g_color.set(newColor.x, newColor.y, newColor.z);
+  // feed every block captured since the last redraw through the stft
+  drainCaptureRing();
+  // and analyze the frames that came due
+  analyzeFrames();
 
   switch (g_displayMode) {
     case WATER_FALL:
@@ -837,9 +1876,19 @@ void displayFunc( )
       break;
   }
 
+  // stage timings overlay (needs GLUT's fonts, so not headless)
+  if( g_showHud && !g_headlessPattern )
+  {
+    XScopedTimer timer( g_profiler, STAGE_HUD );
+    drawHud();
+  }
+  g_profiler.record( STAGE_FRAME, XProfiler::now() - start );
+
+  XScopedTimer timer( g_profiler, STAGE_SWAP );
   // flush!
   glFlush( );
   // swap the double buffer
-  glutSwapBuffers( );
+  if( !g_headlessPattern )
+    glutSwapBuffers( );
   g_t += 1;
 }
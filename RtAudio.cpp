@@ -45,6 +45,14 @@
 #include <cstdlib>
 #include <cstring>
 #include <climits>
+#include <chrono>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#endif
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#include <tmmintrin.h>
+#endif
 
 // Static variable definitions.
 const unsigned int RtApi::MAX_SAMPLE_RATES = 14;
@@ -201,6 +209,8 @@ RtApi :: RtApi()
   stream_.userBuffer[1] = 0;
   MUTEX_INITIALIZE( &stream_.mutex );
   showWarnings_ = true;
+  counters_.periodSeconds = 0;
+  resetStreamStats();
 }
 
 RtApi :: ~RtApi()
@@ -283,6 +293,8 @@ void RtApi :: openStream( RtAudio::StreamParameters *oParams,
   stream_.callbackInfo.userData = userData;
 
   if ( options ) options->numberOfBuffers = stream_.nBuffers;
+  counters_.periodSeconds = stream_.bufferSize * 1.0 / stream_.sampleRate;
+  resetStreamStats();
   stream_.state = STREAM_STOPPED;
 }
 
@@ -369,6 +381,65 @@ unsigned int RtApi :: getStreamSampleRate( void )
  return stream_.sampleRate;
 }
 
+RtAudio::StreamStats RtApi :: getStreamStats( void )
+{
+  // No verifyStream(): the counts outlive the stream.
+  RtAudio::StreamStats stats;
+  stats.callbacks = counters_.callbacks.load( std::memory_order_relaxed );
+  stats.inputOverflows = counters_.inputOverflows.load( std::memory_order_relaxed );
+  stats.outputUnderflows = counters_.outputUnderflows.load( std::memory_order_relaxed );
+  stats.callbackOverruns = counters_.callbackOverruns.load( std::memory_order_relaxed );
+  stats.periodSeconds = counters_.periodSeconds;
+  stats.callbackSeconds = counters_.callbackNs.load( std::memory_order_relaxed ) * 1e-9;
+  stats.callbackMaxSeconds = counters_.callbackMaxNs.load( std::memory_order_relaxed ) * 1e-9;
+  for ( unsigned int k=0; k<RTAUDIO_STATS_BUCKETS; k++ )
+    stats.callbackHistogram[k] = counters_.callbackHistogram[k].load( std::memory_order_relaxed );
+
+  return stats;
+}
+
+void RtApi :: resetStreamStats( void )
+{
+  counters_.callbacks.store( 0, std::memory_order_relaxed );
+  counters_.inputOverflows.store( 0, std::memory_order_relaxed );
+  counters_.outputUnderflows.store( 0, std::memory_order_relaxed );
+  counters_.callbackOverruns.store( 0, std::memory_order_relaxed );
+  counters_.callbackNs.store( 0, std::memory_order_relaxed );
+  counters_.callbackMaxNs.store( 0, std::memory_order_relaxed );
+  for ( unsigned int k=0; k<RTAUDIO_STATS_BUCKETS; k++ )
+    counters_.callbackHistogram[k].store( 0, std::memory_order_relaxed );
+}
+
+int RtApi :: runCallback( RtAudioStreamStatus status )
+{
+  RtAudioCallback callback = (RtAudioCallback) stream_.callbackInfo.callback;
+  double streamTime = getStreamTime();
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  int result = callback( stream_.userBuffer[0], stream_.userBuffer[1], stream_.bufferSize,
+                         streamTime, status, stream_.callbackInfo.userData );
+  unsigned long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - start ).count();
+
+  counters_.callbacks.fetch_add( 1, std::memory_order_relaxed );
+  if ( status & RTAUDIO_INPUT_OVERFLOW )
+    counters_.inputOverflows.fetch_add( 1, std::memory_order_relaxed );
+  if ( status & RTAUDIO_OUTPUT_UNDERFLOW )
+    counters_.outputUnderflows.fetch_add( 1, std::memory_order_relaxed );
+  if ( ns * 1e-9 > counters_.periodSeconds )
+    counters_.callbackOverruns.fetch_add( 1, std::memory_order_relaxed );
+  counters_.callbackNs.fetch_add( ns, std::memory_order_relaxed );
+  unsigned long long max = counters_.callbackMaxNs.load( std::memory_order_relaxed );
+  while ( ns > max && !counters_.callbackMaxNs.compare_exchange_weak( max, ns, std::memory_order_relaxed ) );
+
+  // Bucket k holds [2^k, 2^(k+1)) microseconds.
+  unsigned int k = 0;
+  for ( unsigned long long us = ns / 2000; us && k < RTAUDIO_STATS_BUCKETS - 1; us >>= 1 ) k++;
+  counters_.callbackHistogram[k].fetch_add( 1, std::memory_order_relaxed );
+
+  return result;
+}
+
 
 // *************************************************** //
 //
@@ -1469,7 +1540,6 @@ bool RtApiCore :: callbackEvent( AudioDeviceID deviceId,
     return FAILURE;
   }
 
-  CallbackInfo *info = (CallbackInfo *) &stream_.callbackInfo;
   CoreHandle *handle = (CoreHandle *) stream_.apiHandle;
 
   // Check if we were draining the stream and signal is finished.
@@ -1495,8 +1565,6 @@ bool RtApiCore :: callbackEvent( AudioDeviceID deviceId,
   // draining stream or duplex mode AND the input/output devices are
   // different AND this function is called for the input device.
   if ( handle->drainCounter == 0 && ( stream_.mode != DUPLEX || deviceId == outputDevice ) ) {
-    RtAudioCallback callback = (RtAudioCallback) info->callback;
-    double streamTime = getStreamTime();
     RtAudioStreamStatus status = 0;
     if ( stream_.mode != INPUT && handle->xrun[0] == true ) {
       status |= RTAUDIO_OUTPUT_UNDERFLOW;
@@ -1507,8 +1575,7 @@ bool RtApiCore :: callbackEvent( AudioDeviceID deviceId,
       handle->xrun[1] = false;
     }
 
-    handle->drainCounter = callback( stream_.userBuffer[0], stream_.userBuffer[1],
-                                     stream_.bufferSize, streamTime, status, info->userData );
+    handle->drainCounter = runCallback( status );
     if ( handle->drainCounter == 2 ) {
       MUTEX_UNLOCK( &stream_.mutex );
       abortStream();
@@ -2460,8 +2527,6 @@ bool RtApiJack :: callbackEvent( unsigned long nframes )
 
   // Invoke user callback first, to get fresh output data.
   if ( handle->drainCounter == 0 ) {
-    RtAudioCallback callback = (RtAudioCallback) info->callback;
-    double streamTime = getStreamTime();
     RtAudioStreamStatus status = 0;
     if ( stream_.mode != INPUT && handle->xrun[0] == true ) {
       status |= RTAUDIO_OUTPUT_UNDERFLOW;
@@ -2471,8 +2536,7 @@ bool RtApiJack :: callbackEvent( unsigned long nframes )
       status |= RTAUDIO_INPUT_OVERFLOW;
       handle->xrun[1] = false;
     }
-    handle->drainCounter = callback( stream_.userBuffer[0], stream_.userBuffer[1],
-                                     stream_.bufferSize, streamTime, status, info->userData );
+    handle->drainCounter = runCallback( status );
     if ( handle->drainCounter == 2 ) {
       MUTEX_UNLOCK( &stream_.mutex );
       ThreadHandle id;
@@ -3265,7 +3329,6 @@ bool RtApiAsio :: callbackEvent( long bufferIndex )
     return FAILURE;
   }
 
-  CallbackInfo *info = (CallbackInfo *) &stream_.callbackInfo;
   AsioHandle *handle = (AsioHandle *) stream_.apiHandle;
 
   // Check if we were draining the stream and signal if finished.
@@ -3289,8 +3352,6 @@ bool RtApiAsio :: callbackEvent( long bufferIndex )
   // Invoke user callback to get fresh output data UNLESS we are
   // draining stream.
   if ( handle->drainCounter == 0 ) {
-    RtAudioCallback callback = (RtAudioCallback) info->callback;
-    double streamTime = getStreamTime();
     RtAudioStreamStatus status = 0;
     if ( stream_.mode != INPUT && asioXRun == true ) {
       status |= RTAUDIO_OUTPUT_UNDERFLOW;
@@ -3300,8 +3361,7 @@ bool RtApiAsio :: callbackEvent( long bufferIndex )
       status |= RTAUDIO_INPUT_OVERFLOW;
       asioXRun = false;
     }
-    handle->drainCounter = callback( stream_.userBuffer[0], stream_.userBuffer[1],
-                                     stream_.bufferSize, streamTime, status, info->userData );
+    handle->drainCounter = runCallback( status );
     if ( handle->drainCounter == 2 ) {
       //      MUTEX_UNLOCK( &stream_.mutex );
       //      abortStream();
@@ -4598,7 +4658,6 @@ void RtApiDs :: callbackEvent()
     return;
   }
 
-  CallbackInfo *info = (CallbackInfo *) &stream_.callbackInfo;
   DsHandle *handle = (DsHandle *) stream_.apiHandle;
 
   // Check if we were draining the stream and signal is finished.
@@ -4623,8 +4682,6 @@ void RtApiDs :: callbackEvent()
   // Invoke user callback to get fresh output data UNLESS we are
   // draining stream.
   if ( handle->drainCounter == 0 ) {
-    RtAudioCallback callback = (RtAudioCallback) info->callback;
-    double streamTime = getStreamTime();
     RtAudioStreamStatus status = 0;
     if ( stream_.mode != INPUT && handle->xrun[0] == true ) {
       status |= RTAUDIO_OUTPUT_UNDERFLOW;
@@ -4634,8 +4691,7 @@ void RtApiDs :: callbackEvent()
       status |= RTAUDIO_INPUT_OVERFLOW;
       handle->xrun[1] = false;
     }
-    handle->drainCounter = callback( stream_.userBuffer[0], stream_.userBuffer[1],
-                                     stream_.bufferSize, streamTime, status, info->userData );
+    handle->drainCounter = runCallback( status );
     if ( handle->drainCounter == 2 ) {
       //      MUTEX_UNLOCK( &stream_.mutex );
       abortStream();
@@ -5150,18 +5206,19 @@ struct AlsaHandle {
   snd_pcm_t *handles[2];
   bool synchronized;
   bool xrun[2];
+  bool mmap;  // input uses mmap access (RTAUDIO_ALSA_MMAP)
   pthread_cond_t runnable_cv;
   bool runnable;
 
   AlsaHandle()
-    :synchronized(false), runnable(false) { xrun[0] = false; xrun[1] = false; }
+    :synchronized(false), mmap(false), runnable(false) { xrun[0] = false; xrun[1] = false; }
 };
 
 extern "C" void *alsaCallbackHandler( void * ptr );
 
 RtApiAlsa :: RtApiAlsa()
+  : mmapConvertReady_( false ), mmapFirstChannel_( 0 )
 {
-  // Nothing to do here.
 }
 
 RtApiAlsa :: ~RtApiAlsa()
@@ -5583,8 +5640,35 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
   snd_pcm_hw_params_dump( hw_params, out );
 #endif
 
-  // Set access ... check user preference.
-  if ( options && options->flags & RTAUDIO_NONINTERLEAVED ) {
+  // Set access ... check user preference.  Input may ask for mmap
+  // access (either interleaving will do); without it, fall back to
+  // read/write access below.
+  bool useMmap = false;
+  if ( mode == INPUT && options && options->flags & RTAUDIO_ALSA_MMAP ) {
+    bool interleaved = !( options->flags & RTAUDIO_NONINTERLEAVED );
+    result = snd_pcm_hw_params_set_access( phandle, hw_params, interleaved ?
+                                           SND_PCM_ACCESS_MMAP_INTERLEAVED : SND_PCM_ACCESS_MMAP_NONINTERLEAVED );
+    if ( result < 0 ) {
+      interleaved = !interleaved;
+      result = snd_pcm_hw_params_set_access( phandle, hw_params, interleaved ?
+                                             SND_PCM_ACCESS_MMAP_INTERLEAVED : SND_PCM_ACCESS_MMAP_NONINTERLEAVED );
+    }
+    if ( result >= 0 ) {
+      useMmap = true;
+      stream_.userInterleaved = !( options->flags & RTAUDIO_NONINTERLEAVED );
+      stream_.deviceInterleaved[mode] = interleaved;
+    }
+    else {
+      errorStream_ << "RtApiAlsa::probeDeviceOpen: pcm device (" << name << ") has no mmap access, using read/write.";
+      errorText_ = errorStream_.str();
+      error( RtError::WARNING );
+    }
+  }
+
+  if ( useMmap ) {
+    // access already set
+  }
+  else if ( options && options->flags & RTAUDIO_NONINTERLEAVED ) {
     stream_.userInterleaved = false;
     result = snd_pcm_hw_params_set_access( phandle, hw_params, SND_PCM_ACCESS_RW_NONINTERLEAVED );
     if ( result < 0 ) {
@@ -5855,6 +5939,11 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
     apiInfo = (AlsaHandle *) stream_.apiHandle;
   }
   apiInfo->handles[mode] = phandle;
+  if ( mode == INPUT ) {
+    apiInfo->mmap = useMmap;
+    mmapConvertReady_ = false;
+    mmapFirstChannel_ = firstChannel;
+  }
 
   // Allocate necessary internal buffers.
   unsigned long bufferBytes;
@@ -5869,7 +5958,9 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
 
     bool makeBuffer = true;
     bufferBytes = stream_.nDeviceChannels[mode] * formatBytes( stream_.deviceFormat[mode] );
-    if ( mode == INPUT ) {
+    // mmap input converts out of the dma area, no device buffer needed
+    if ( mode == INPUT && useMmap ) makeBuffer = false;
+    else if ( mode == INPUT ) {
       if ( stream_.mode == OUTPUT && stream_.deviceBuffer ) {
         unsigned long bytesOut = stream_.nDeviceChannels[0] * formatBytes( stream_.deviceFormat[0] );
         if ( bufferBytes <= bytesOut ) makeBuffer = false;
@@ -5892,8 +5983,9 @@ bool RtApiAlsa :: probeDeviceOpen( unsigned int device, StreamMode mode, unsigne
   stream_.device[mode] = device;
   stream_.state = STREAM_STOPPED;
 
-  // Setup the buffer conversion information structure.
-  if ( stream_.doConvertBuffer[mode] ) setConvertInfo( mode, firstChannel );
+  // Setup the buffer conversion information structure.  Mmap input
+  // always goes through it: it is also the copy out of the dma area.
+  if ( stream_.doConvertBuffer[mode] || useMmap ) setConvertInfo( mode, firstChannel );
 
   // Setup thread if necessary.
   if ( stream_.mode == OUTPUT && mode == INPUT ) {
@@ -6196,8 +6288,6 @@ void RtApiAlsa :: callbackEvent()
   }
 
   int doStopStream = 0;
-  RtAudioCallback callback = (RtAudioCallback) stream_.callbackInfo.callback;
-  double streamTime = getStreamTime();
   RtAudioStreamStatus status = 0;
   if ( stream_.mode != INPUT && apiInfo->xrun[0] == true ) {
     status |= RTAUDIO_OUTPUT_UNDERFLOW;
@@ -6207,8 +6297,7 @@ void RtApiAlsa :: callbackEvent()
     status |= RTAUDIO_INPUT_OVERFLOW;
     apiInfo->xrun[1] = false;
   }
-  doStopStream = callback( stream_.userBuffer[0], stream_.userBuffer[1],
-                           stream_.bufferSize, streamTime, status, stream_.callbackInfo.userData );
+  doStopStream = runCallback( status );
 
   if ( doStopStream == 2 ) {
     abortStream();
@@ -6228,7 +6317,33 @@ void RtApiAlsa :: callbackEvent()
   RtAudioFormat format;
   handle = (snd_pcm_t **) apiInfo->handles;
 
-  if ( stream_.mode == INPUT || stream_.mode == DUPLEX ) {
+  if ( ( stream_.mode == INPUT || stream_.mode == DUPLEX ) && apiInfo->mmap ) {
+
+    // Convert straight out of the dma area (byte swapping included).
+    result = captureMmap();
+    if ( result < (int) stream_.bufferSize ) {
+      // Either an error or overrun occured.
+      if ( result == -EPIPE ) {
+        apiInfo->xrun[1] = true;
+        result = snd_pcm_prepare( handle[1] );
+        if ( result < 0 ) {
+          errorStream_ << "RtApiAlsa::callbackEvent: error preparing device after overrun, " << snd_strerror( result ) << ".";
+          errorText_ = errorStream_.str();
+        }
+      }
+      else {
+        errorStream_ << "RtApiAlsa::callbackEvent: audio mmap read error, " << snd_strerror( result ) << ".";
+        errorText_ = errorStream_.str();
+      }
+      error( RtError::WARNING );
+      goto tryOutput;
+    }
+
+    // Check stream latency
+    result = snd_pcm_delay( handle[1], &frames );
+    if ( result == 0 && frames > 0 ) stream_.latency[1] = frames;
+  }
+  else if ( stream_.mode == INPUT || stream_.mode == DUPLEX ) {
 
     // Setup parameters.
     if ( stream_.doConvertBuffer[1] ) {
@@ -6360,6 +6475,84 @@ void RtApiAlsa :: callbackEvent()
   if ( doStopStream == 1 ) this->stopStream();
 }
 
+int RtApiAlsa :: captureMmap( void )
+{
+  // Read one buffer through snd_pcm_mmap_begin/commit.  Each contiguous
+  // run of the dma area is byte swapped in place if needed and converted
+  // directly into the user buffer, so the samples are touched once.
+  // Returns the frames read (the buffer size) or a negative error code.
+  AlsaHandle *apiInfo = (AlsaHandle *) stream_.apiHandle;
+  snd_pcm_t *handle = apiInfo->handles[1];
+  RtAudioFormat format = stream_.deviceFormat[1];
+  unsigned int bytes = formatBytes( format );
+  unsigned int userFrameBytes = formatBytes( stream_.userFormat ) *
+    ( stream_.userInterleaved ? stream_.nUserChannels[1] : 1 );
+  snd_pcm_uframes_t done = 0;
+  int result;
+
+  // Unlike snd_pcm_readi, nothing here starts the device.
+  if ( snd_pcm_state( handle ) == SND_PCM_STATE_PREPARED ) {
+    result = snd_pcm_start( handle );
+    if ( result < 0 ) return result;
+  }
+
+  while ( done < stream_.bufferSize ) {
+    snd_pcm_sframes_t avail = snd_pcm_avail_update( handle );
+    if ( avail < 0 ) return avail;
+    if ( avail == 0 ) {
+      result = snd_pcm_wait( handle, -1 );
+      if ( result < 0 ) return result;
+      continue;
+    }
+
+    const snd_pcm_channel_area_t *areas;
+    snd_pcm_uframes_t offset, count = stream_.bufferSize - done;
+    if ( count > (snd_pcm_uframes_t) avail ) count = avail;
+    result = snd_pcm_mmap_begin( handle, &areas, &offset, &count );
+    if ( result < 0 ) return result;
+
+    // The areas are fixed once the hardware parameters are installed:
+    // turn them into offsets (in samples) from channel 0's first sample.
+    char *base = (char *) areas[0].addr + areas[0].first / 8;
+    if ( !mmapConvertReady_ ) {
+      for ( unsigned int c=0; c<stream_.nDeviceChannels[1]; c++ ) {
+        char *start = (char *) areas[c].addr + areas[c].first / 8;
+        if ( areas[c].first % 8 || areas[c].step != areas[0].step ||
+             areas[c].step % ( 8 * bytes ) || ( start - base ) % (long) bytes ) {
+          snd_pcm_mmap_commit( handle, offset, 0 );
+          return -EINVAL;
+        }
+      }
+      mmapConvert_ = stream_.convertInfo[1];
+      mmapConvert_.inJump = areas[0].step / ( 8 * bytes );
+      for ( int k=0; k<mmapConvert_.channels; k++ ) {
+        const snd_pcm_channel_area_t *area = &areas[mmapFirstChannel_ + k];
+        mmapConvert_.inOffset[k] = ( (char *) area->addr + area->first / 8 - base ) / (long) bytes;
+      }
+      mmapConvertReady_ = true;
+    }
+
+    char *in = base + offset * ( areas[0].step / 8 );
+    if ( stream_.doByteSwap[1] ) {
+      if ( stream_.deviceInterleaved[1] )
+        byteSwapBuffer( in, count * stream_.nDeviceChannels[1], format );
+      else {
+        for ( int k=0; k<mmapConvert_.channels; k++ )
+          byteSwapBuffer( in + mmapConvert_.inOffset[k] * bytes, count, format );
+      }
+    }
+    convertBuffer( stream_.userBuffer[1] + done * userFrameBytes, in, mmapConvert_, count );
+
+    snd_pcm_sframes_t committed = snd_pcm_mmap_commit( handle, offset, count );
+    if ( committed < 0 ) return committed;
+    // A short commit means the device overran the area being read.
+    if ( (snd_pcm_uframes_t) committed != count ) return -EPIPE;
+    done += count;
+  }
+
+  return done;
+}
+
 extern "C" void *alsaCallbackHandler( void *ptr )
 {
   CallbackInfo *info = (CallbackInfo *) ptr;
@@ -7184,8 +7377,6 @@ void RtApiOss :: callbackEvent()
 
   // Invoke user callback to get fresh output data.
   int doStopStream = 0;
-  RtAudioCallback callback = (RtAudioCallback) stream_.callbackInfo.callback;
-  double streamTime = getStreamTime();
   RtAudioStreamStatus status = 0;
   if ( stream_.mode != INPUT && handle->xrun[0] == true ) {
     status |= RTAUDIO_OUTPUT_UNDERFLOW;
@@ -7195,8 +7386,7 @@ void RtApiOss :: callbackEvent()
     status |= RTAUDIO_INPUT_OVERFLOW;
     handle->xrun[1] = false;
   }
-  doStopStream = callback( stream_.userBuffer[0], stream_.userBuffer[1],
-                           stream_.bufferSize, streamTime, status, stream_.callbackInfo.userData );
+  doStopStream = runCallback( status );
   if ( doStopStream == 2 ) {
     this->abortStream();
     return;
@@ -7472,7 +7662,252 @@ void RtApi :: setConvertInfo( StreamMode mode, unsigned int firstChannel )
   }
 }
 
+// Fast paths for convertBuffer(): 16/24/32-bit integer or Float32 input
+// to Float32 output, the conversions every capture stream does.  Each
+// sample gets exactly the arithmetic of the generic loops, ( x + 0.5 ) *
+// scale in single precision, so results are bit-identical; only the
+// addressing changes (`bench --verify` checks this against
+// convertBufferGeneric()).  Runs of four use SSE2, which every x86-64 cpu
+// has.  Define __RTAUDIO_NO_FAST_CONVERT__ to always take the generic loops.
+struct ConvertFromInt16 {
+  typedef short Sample;
+  static const bool integer = true;
+  static float scale() { return (float) ( 1.0 / 32767.5 ); }
+  static float get( const short *in ) { return (float) *in; }
+#if defined(__SSE2__)
+  static __m128 get4( const short *in ) {
+    __m128i v = _mm_loadl_epi64( (const __m128i *) in );
+    return _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( v, v ), 16 ) );
+  }
+#endif
+};
+
+struct ConvertFromInt24 {
+  // as in the generic loop, only the low three bytes count (no sign extension)
+  typedef int Sample;
+  static const bool integer = true;
+  static float scale() { return (float) ( 1.0 / 8388607.5 ); }
+  static float get( const int *in ) { return (float) ( *in & 0x00ffffff ); }
+#if defined(__SSE2__)
+  static __m128 get4( const int *in ) {
+    __m128i v = _mm_loadu_si128( (const __m128i *) in );
+    return _mm_cvtepi32_ps( _mm_and_si128( v, _mm_set1_epi32( 0x00ffffff ) ) );
+  }
+#endif
+};
+
+struct ConvertFromInt32 {
+  typedef int Sample;
+  static const bool integer = true;
+  static float scale() { return (float) ( 1.0 / 2147483647.5 ); }
+  static float get( const int *in ) { return (float) *in; }
+#if defined(__SSE2__)
+  static __m128 get4( const int *in ) {
+    return _mm_cvtepi32_ps( _mm_loadu_si128( (const __m128i *) in ) );
+  }
+#endif
+};
+
+struct ConvertFromFloat32 {
+  // channel compensation and/or (de)interleaving only
+  typedef float Sample;
+  static const bool integer = false;
+  static float scale() { return 1; }
+  static float get( const float *in ) { return *in; }
+#if defined(__SSE2__)
+  static __m128 get4( const float *in ) { return _mm_loadu_ps( in ); }
+#endif
+};
+
+template <class F>
+static inline float convertOne( const typename F::Sample *in )
+{
+  float f = F::get( in );
+  if ( F::integer ) {
+    f += 0.5f;
+    f *= F::scale();
+  }
+  return f;
+}
+
+#if defined(__SSE2__)
+template <class F>
+static inline __m128 convertFour( const typename F::Sample *in )
+{
+  __m128 v = F::get4( in );
+  if ( F::integer )
+    v = _mm_mul_ps( _mm_add_ps( v, _mm_set1_ps( 0.5f ) ), _mm_set1_ps( F::scale() ) );
+  return v;
+}
+#endif
+
+// n consecutive samples to n consecutive floats
+template <class F>
+static void convertRun( float *out, const typename F::Sample *in, unsigned int n )
+{
+  unsigned int i = 0;
+#if defined(__SSE2__)
+  for ( ; i + 4 <= n; i += 4 )
+    _mm_storeu_ps( out + i, convertFour<F>( in + i ) );
+#endif
+  for ( ; i < n; i++ )
+    out[i] = convertOne<F>( in + i );
+}
+
+// interleaved frames (channels consecutive from in, inJump apart) to one
+// plane per channel (at out + outOffset[k]), transposing 4x4 blocks
+template <class F>
+static void convertDeinterleave( float *out, const int *outOffset,
+                                 const typename F::Sample *in, int inJump,
+                                 int channels, unsigned int frames )
+{
+  int k = 0;
+#if defined(__SSE2__)
+  for ( ; k + 4 <= channels; k += 4 ) {
+    float *o0 = out + outOffset[k], *o1 = out + outOffset[k+1];
+    float *o2 = out + outOffset[k+2], *o3 = out + outOffset[k+3];
+    const typename F::Sample *p = in + k;
+    unsigned int i = 0;
+    for ( ; i + 4 <= frames; i += 4, p += 4 * inJump ) {
+      __m128 r0 = convertFour<F>( p );
+      __m128 r1 = convertFour<F>( p + inJump );
+      __m128 r2 = convertFour<F>( p + 2 * inJump );
+      __m128 r3 = convertFour<F>( p + 3 * inJump );
+      _MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+      _mm_storeu_ps( o0 + i, r0 );
+      _mm_storeu_ps( o1 + i, r1 );
+      _mm_storeu_ps( o2 + i, r2 );
+      _mm_storeu_ps( o3 + i, r3 );
+    }
+    for ( ; i < frames; i++, p += inJump ) {
+      o0[i] = convertOne<F>( p );
+      o1[i] = convertOne<F>( p + 1 );
+      o2[i] = convertOne<F>( p + 2 );
+      o3[i] = convertOne<F>( p + 3 );
+    }
+  }
+#endif
+  for ( ; k < channels; k++ ) {
+    float *o = out + outOffset[k];
+    const typename F::Sample *p = in + k;
+    for ( unsigned int i = 0; i < frames; i++, p += inJump )
+      o[i] = convertOne<F>( p );
+  }
+}
+
+// one plane per channel (at in + inOffset[k]) to interleaved frames
+// (channels consecutive from out, outJump apart)
+template <class F>
+static void convertInterleave( float *out, int outJump,
+                               const typename F::Sample *in, const int *inOffset,
+                               int channels, unsigned int frames )
+{
+  int k = 0;
+#if defined(__SSE2__)
+  for ( ; k + 4 <= channels; k += 4 ) {
+    const typename F::Sample *p0 = in + inOffset[k], *p1 = in + inOffset[k+1];
+    const typename F::Sample *p2 = in + inOffset[k+2], *p3 = in + inOffset[k+3];
+    float *o = out + k;
+    unsigned int i = 0;
+    for ( ; i + 4 <= frames; i += 4, o += 4 * outJump ) {
+      __m128 r0 = convertFour<F>( p0 + i );
+      __m128 r1 = convertFour<F>( p1 + i );
+      __m128 r2 = convertFour<F>( p2 + i );
+      __m128 r3 = convertFour<F>( p3 + i );
+      _MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+      _mm_storeu_ps( o, r0 );
+      _mm_storeu_ps( o + outJump, r1 );
+      _mm_storeu_ps( o + 2 * outJump, r2 );
+      _mm_storeu_ps( o + 3 * outJump, r3 );
+    }
+    for ( ; i < frames; i++, o += outJump ) {
+      o[0] = convertOne<F>( p0 + i );
+      o[1] = convertOne<F>( p1 + i );
+      o[2] = convertOne<F>( p2 + i );
+      o[3] = convertOne<F>( p3 + i );
+    }
+  }
+#endif
+  for ( ; k < channels; k++ ) {
+    const typename F::Sample *p = in + inOffset[k];
+    float *o = out + k;
+    for ( unsigned int i = 0; i < frames; i++, o += outJump )
+      *o = convertOne<F>( p + i );
+  }
+}
+
+template <class F>
+static bool convertFast( char *outBuffer, char *inBuffer, int channels,
+                         int inJump, int outJump, const int *inOffset,
+                         const int *outOffset, unsigned int frames )
+{
+  float *out = (float *) outBuffer;
+  const typename F::Sample *in = (const typename F::Sample *) inBuffer;
+
+  // channels packed together, in order, on each side?
+  bool inPacked = true, outPacked = true;
+  for ( int k=1; k<channels; k++ ) {
+    if ( inOffset[k] != inOffset[0] + k ) inPacked = false;
+    if ( outOffset[k] != outOffset[0] + k ) outPacked = false;
+  }
+
+  if ( inPacked && outPacked && inJump == channels && outJump == channels ) {
+    // identity channel map: one flat run
+    convertRun<F>( out + outOffset[0], in + inOffset[0], frames * channels );
+  }
+  else if ( inJump == 1 && outJump == 1 ) {
+    // non-interleaved both sides
+    for ( int k=0; k<channels; k++ )
+      convertRun<F>( out + outOffset[k], in + inOffset[k], frames );
+  }
+  else if ( outJump == 1 && inPacked ) {
+    convertDeinterleave<F>( out, outOffset, in + inOffset[0], inJump, channels, frames );
+  }
+  else if ( inJump == 1 && outPacked ) {
+    convertInterleave<F>( out + outOffset[0], outJump, in, inOffset, channels, frames );
+  }
+  else if ( inPacked && outPacked ) {
+    // interleaved both sides, a block of the device channels
+    for ( unsigned int i=0; i<frames; i++ )
+      convertRun<F>( out + i * outJump + outOffset[0], in + i * inJump + inOffset[0], channels );
+  }
+  else
+    return false;
+
+  return true;
+}
+
+bool RtApi :: convertBufferFast( char *outBuffer, char *inBuffer, ConvertInfo &info, unsigned int frames )
+{
+#if defined(__RTAUDIO_NO_FAST_CONVERT__)
+  return false;
+#else
+  if ( info.outFormat != RTAUDIO_FLOAT32 || info.channels < 1 ) return false;
+
+  const int *inOffset = &info.inOffset[0];
+  const int *outOffset = &info.outOffset[0];
+  if ( info.inFormat == RTAUDIO_SINT16 )
+    return convertFast<ConvertFromInt16>( outBuffer, inBuffer, info.channels, info.inJump,
+                                          info.outJump, inOffset, outOffset, frames );
+  if ( info.inFormat == RTAUDIO_SINT24 )
+    return convertFast<ConvertFromInt24>( outBuffer, inBuffer, info.channels, info.inJump,
+                                          info.outJump, inOffset, outOffset, frames );
+  if ( info.inFormat == RTAUDIO_SINT32 )
+    return convertFast<ConvertFromInt32>( outBuffer, inBuffer, info.channels, info.inJump,
+                                          info.outJump, inOffset, outOffset, frames );
+  if ( info.inFormat == RTAUDIO_FLOAT32 )
+    return convertFast<ConvertFromFloat32>( outBuffer, inBuffer, info.channels, info.inJump,
+                                            info.outJump, inOffset, outOffset, frames );
+  return false;
+#endif
+}
+
 void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info )
+{
+  convertBuffer( outBuffer, inBuffer, info, stream_.bufferSize );
+}
+
+void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info, unsigned int frames )
 {
   // This function does format conversion, input/output channel compensation, and
   // data interleaving/deinterleaving.  24-bit integers are assumed to occupy
@@ -7481,8 +7916,16 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
   // Clear our device buffer when in/out duplex device channels are different
   if ( outBuffer == stream_.deviceBuffer && stream_.mode == DUPLEX &&
        ( stream_.nDeviceChannels[0] < stream_.nDeviceChannels[1] ) )
-    memset( outBuffer, 0, stream_.bufferSize * info.outJump * formatBytes( info.outFormat ) );
+    memset( outBuffer, 0, frames * info.outJump * formatBytes( info.outFormat ) );
 
+  // Common cases first; see convertBufferFast().
+  if ( convertBufferFast( outBuffer, inBuffer, info, frames ) ) return;
+
+  convertBufferGeneric( outBuffer, inBuffer, info, frames );
+}
+
+void RtApi :: convertBufferGeneric( char *outBuffer, char *inBuffer, ConvertInfo &info, unsigned int frames )
+{
   int j;
   if (info.outFormat == RTAUDIO_FLOAT64) {
     Float64 scale;
@@ -7491,7 +7934,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     if (info.inFormat == RTAUDIO_SINT8) {
       signed char *in = (signed char *)inBuffer;
       scale = 1.0 / 127.5;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Float64) in[info.inOffset[j]];
           out[info.outOffset[j]] += 0.5;
@@ -7504,7 +7947,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     else if (info.inFormat == RTAUDIO_SINT16) {
       Int16 *in = (Int16 *)inBuffer;
       scale = 1.0 / 32767.5;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Float64) in[info.inOffset[j]];
           out[info.outOffset[j]] += 0.5;
@@ -7517,7 +7960,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     else if (info.inFormat == RTAUDIO_SINT24) {
       Int32 *in = (Int32 *)inBuffer;
       scale = 1.0 / 8388607.5;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Float64) (in[info.inOffset[j]] & 0x00ffffff);
           out[info.outOffset[j]] += 0.5;
@@ -7530,7 +7973,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     else if (info.inFormat == RTAUDIO_SINT32) {
       Int32 *in = (Int32 *)inBuffer;
       scale = 1.0 / 2147483647.5;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Float64) in[info.inOffset[j]];
           out[info.outOffset[j]] += 0.5;
@@ -7542,7 +7985,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_FLOAT32) {
       Float32 *in = (Float32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Float64) in[info.inOffset[j]];
         }
@@ -7553,7 +7996,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     else if (info.inFormat == RTAUDIO_FLOAT64) {
       // Channel compensation and/or (de)interleaving only.
       Float64 *in = (Float64 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = in[info.inOffset[j]];
         }
@@ -7569,7 +8012,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     if (info.inFormat == RTAUDIO_SINT8) {
       signed char *in = (signed char *)inBuffer;
       scale = (Float32) ( 1.0 / 127.5 );
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Float32) in[info.inOffset[j]];
           out[info.outOffset[j]] += 0.5;
@@ -7582,7 +8025,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     else if (info.inFormat == RTAUDIO_SINT16) {
       Int16 *in = (Int16 *)inBuffer;
       scale = (Float32) ( 1.0 / 32767.5 );
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Float32) in[info.inOffset[j]];
           out[info.outOffset[j]] += 0.5;
@@ -7595,7 +8038,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     else if (info.inFormat == RTAUDIO_SINT24) {
       Int32 *in = (Int32 *)inBuffer;
       scale = (Float32) ( 1.0 / 8388607.5 );
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Float32) (in[info.inOffset[j]] & 0x00ffffff);
           out[info.outOffset[j]] += 0.5;
@@ -7608,7 +8051,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     else if (info.inFormat == RTAUDIO_SINT32) {
       Int32 *in = (Int32 *)inBuffer;
       scale = (Float32) ( 1.0 / 2147483647.5 );
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Float32) in[info.inOffset[j]];
           out[info.outOffset[j]] += 0.5;
@@ -7621,7 +8064,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     else if (info.inFormat == RTAUDIO_FLOAT32) {
       // Channel compensation and/or (de)interleaving only.
       Float32 *in = (Float32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = in[info.inOffset[j]];
         }
@@ -7631,7 +8074,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_FLOAT64) {
       Float64 *in = (Float64 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Float32) in[info.inOffset[j]];
         }
@@ -7644,7 +8087,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     Int32 *out = (Int32 *)outBuffer;
     if (info.inFormat == RTAUDIO_SINT8) {
       signed char *in = (signed char *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int32) in[info.inOffset[j]];
           out[info.outOffset[j]] <<= 24;
@@ -7655,7 +8098,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_SINT16) {
       Int16 *in = (Int16 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int32) in[info.inOffset[j]];
           out[info.outOffset[j]] <<= 16;
@@ -7666,7 +8109,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_SINT24) { // Hmmm ... we could just leave it in the lower 3 bytes
       Int32 *in = (Int32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int32) in[info.inOffset[j]];
           out[info.outOffset[j]] <<= 8;
@@ -7678,7 +8121,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     else if (info.inFormat == RTAUDIO_SINT32) {
       // Channel compensation and/or (de)interleaving only.
       Int32 *in = (Int32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = in[info.inOffset[j]];
         }
@@ -7688,7 +8131,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_FLOAT32) {
       Float32 *in = (Float32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int32) (in[info.inOffset[j]] * 2147483647.5 - 0.5);
         }
@@ -7698,7 +8141,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_FLOAT64) {
       Float64 *in = (Float64 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int32) (in[info.inOffset[j]] * 2147483647.5 - 0.5);
         }
@@ -7711,7 +8154,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     Int32 *out = (Int32 *)outBuffer;
     if (info.inFormat == RTAUDIO_SINT8) {
       signed char *in = (signed char *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int32) in[info.inOffset[j]];
           out[info.outOffset[j]] <<= 16;
@@ -7722,7 +8165,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_SINT16) {
       Int16 *in = (Int16 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int32) in[info.inOffset[j]];
           out[info.outOffset[j]] <<= 8;
@@ -7734,7 +8177,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     else if (info.inFormat == RTAUDIO_SINT24) {
       // Channel compensation and/or (de)interleaving only.
       Int32 *in = (Int32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = in[info.inOffset[j]];
         }
@@ -7744,7 +8187,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_SINT32) {
       Int32 *in = (Int32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int32) in[info.inOffset[j]];
           out[info.outOffset[j]] >>= 8;
@@ -7755,7 +8198,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_FLOAT32) {
       Float32 *in = (Float32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int32) (in[info.inOffset[j]] * 8388607.5 - 0.5);
         }
@@ -7765,7 +8208,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_FLOAT64) {
       Float64 *in = (Float64 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int32) (in[info.inOffset[j]] * 8388607.5 - 0.5);
         }
@@ -7778,7 +8221,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     Int16 *out = (Int16 *)outBuffer;
     if (info.inFormat == RTAUDIO_SINT8) {
       signed char *in = (signed char *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int16) in[info.inOffset[j]];
           out[info.outOffset[j]] <<= 8;
@@ -7790,7 +8233,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     else if (info.inFormat == RTAUDIO_SINT16) {
       // Channel compensation and/or (de)interleaving only.
       Int16 *in = (Int16 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = in[info.inOffset[j]];
         }
@@ -7800,7 +8243,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_SINT24) {
       Int32 *in = (Int32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int16) ((in[info.inOffset[j]] >> 8) & 0x0000ffff);
         }
@@ -7810,7 +8253,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_SINT32) {
       Int32 *in = (Int32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int16) ((in[info.inOffset[j]] >> 16) & 0x0000ffff);
         }
@@ -7820,7 +8263,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_FLOAT32) {
       Float32 *in = (Float32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int16) (in[info.inOffset[j]] * 32767.5 - 0.5);
         }
@@ -7830,7 +8273,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_FLOAT64) {
       Float64 *in = (Float64 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (Int16) (in[info.inOffset[j]] * 32767.5 - 0.5);
         }
@@ -7844,7 +8287,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     if (info.inFormat == RTAUDIO_SINT8) {
       // Channel compensation and/or (de)interleaving only.
       signed char *in = (signed char *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = in[info.inOffset[j]];
         }
@@ -7854,7 +8297,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     if (info.inFormat == RTAUDIO_SINT16) {
       Int16 *in = (Int16 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (signed char) ((in[info.inOffset[j]] >> 8) & 0x00ff);
         }
@@ -7864,7 +8307,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_SINT24) {
       Int32 *in = (Int32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (signed char) ((in[info.inOffset[j]] >> 16) & 0x000000ff);
         }
@@ -7874,7 +8317,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_SINT32) {
       Int32 *in = (Int32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (signed char) ((in[info.inOffset[j]] >> 24) & 0x000000ff);
         }
@@ -7884,7 +8327,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_FLOAT32) {
       Float32 *in = (Float32 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (signed char) (in[info.inOffset[j]] * 127.5 - 0.5);
         }
@@ -7894,7 +8337,7 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
     }
     else if (info.inFormat == RTAUDIO_FLOAT64) {
       Float64 *in = (Float64 *)inBuffer;
-      for (unsigned int i=0; i<stream_.bufferSize; i++) {
+      for (unsigned int i=0; i<frames; i++) {
         for (j=0; j<info.channels; j++) {
           out[info.outOffset[j]] = (signed char) (in[info.inOffset[j]] * 127.5 - 0.5);
         }
@@ -7909,7 +8352,94 @@ void RtApi :: convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info
   //static inline uint32_t bswap_32(uint32_t x) { return (bswap_16(x&0xffff)<<16) | (bswap_16(x>>16)); }
   //static inline uint64_t bswap_64(uint64_t x) { return (((unsigned long long)bswap_32(x&0xffffffffull))<<32) | (bswap_32(x>>32)); }
 
+// Byte swapping for byteSwapBuffer(): whole 16-byte vectors at a time,
+// leaving the remainder to byteSwapBufferGeneric().  pshufb reverses every
+// sample in one instruction when the cpu has SSSE3 (checked at run time,
+// as for the FFT kernels); otherwise SSE2 swaps 16-bit words with
+// shuffles and the bytes within them with shifts.
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) ) && !defined(__RTAUDIO_NO_FAST_CONVERT__)
+
+// pshufb byte orders for 2, 4 and 8 byte samples
+static const char byteSwapOrder[3][16] = {
+  { 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14 },
+  { 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12 },
+  { 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8 }
+};
+
+__attribute__((target("ssse3")))
+static unsigned int byteSwapSsse3( char *buffer, unsigned int bytes, int order )
+{
+  __m128i mask = _mm_loadu_si128( (const __m128i *) byteSwapOrder[order] );
+  unsigned int i = 0;
+  for ( ; i + 32 <= bytes; i += 32 ) {
+    __m128i a = _mm_loadu_si128( (const __m128i *) ( buffer + i ) );
+    __m128i b = _mm_loadu_si128( (const __m128i *) ( buffer + i + 16 ) );
+    _mm_storeu_si128( (__m128i *) ( buffer + i ), _mm_shuffle_epi8( a, mask ) );
+    _mm_storeu_si128( (__m128i *) ( buffer + i + 16 ), _mm_shuffle_epi8( b, mask ) );
+  }
+  for ( ; i + 16 <= bytes; i += 16 ) {
+    __m128i a = _mm_loadu_si128( (const __m128i *) ( buffer + i ) );
+    _mm_storeu_si128( (__m128i *) ( buffer + i ), _mm_shuffle_epi8( a, mask ) );
+  }
+  return i;
+}
+
+__attribute__((target("sse2")))
+static unsigned int byteSwapSse2( char *buffer, unsigned int bytes, int order )
+{
+  unsigned int i = 0;
+  for ( ; i + 16 <= bytes; i += 16 ) {
+    __m128i v = _mm_loadu_si128( (const __m128i *) ( buffer + i ) );
+    if ( order == 1 ) {
+      v = _mm_shufflelo_epi16( v, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+      v = _mm_shufflehi_epi16( v, _MM_SHUFFLE( 2, 3, 0, 1 ) );
+    }
+    else if ( order == 2 ) {
+      v = _mm_shufflelo_epi16( v, _MM_SHUFFLE( 0, 1, 2, 3 ) );
+      v = _mm_shufflehi_epi16( v, _MM_SHUFFLE( 0, 1, 2, 3 ) );
+    }
+    v = _mm_or_si128( _mm_slli_epi16( v, 8 ), _mm_srli_epi16( v, 8 ) );
+    _mm_storeu_si128( (__m128i *) ( buffer + i ), v );
+  }
+  return i;
+}
+
+// swap the leading whole vectors of bytes bytes of width-byte samples;
+// returns the bytes done
+static unsigned int byteSwapVector( char *buffer, unsigned int bytes, unsigned int width )
+{
+  static const bool ssse3 = __builtin_cpu_supports( "ssse3" );
+  static const bool sse2 = __builtin_cpu_supports( "sse2" );
+  int order = width == 2 ? 0 : width == 4 ? 1 : 2;
+  if ( ssse3 ) return byteSwapSsse3( buffer, bytes, order );
+  if ( sse2 ) return byteSwapSse2( buffer, bytes, order );
+  return 0;
+}
+
+#else
+
+static unsigned int byteSwapVector( char *, unsigned int, unsigned int ) { return 0; }
+
+#endif
+
 void RtApi :: byteSwapBuffer( char *buffer, unsigned int samples, RtAudioFormat format )
+{
+  // Whole vectors first, then the generic loops take what is left.
+  unsigned int width = 0;
+  if ( format == RTAUDIO_SINT16 ) width = 2;
+  else if ( format == RTAUDIO_SINT24 || format == RTAUDIO_SINT32 ||
+            format == RTAUDIO_FLOAT32 ) width = 4;
+  else if ( format == RTAUDIO_FLOAT64 ) width = 8;
+  if ( width ) {
+    unsigned int done = byteSwapVector( buffer, samples * width, width );
+    buffer += done;
+    samples -= done / width;
+  }
+
+  byteSwapBufferGeneric( buffer, samples, format );
+}
+
+void RtApi :: byteSwapBufferGeneric( char *buffer, unsigned int samples, RtAudioFormat format )
 {
   register char val;
   register char *ptr;
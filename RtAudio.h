@@ -49,6 +49,7 @@
 
 #include <string>
 #include <vector>
+#include <atomic>
 #include "RtError.h"
 
 /*! \typedef typedef unsigned long RtAudioFormat;
@@ -87,6 +88,7 @@ static const RtAudioFormat RTAUDIO_FLOAT64 = 0x20; // Normalized between plus/mi
     - \e RTAUDIO_MINIMIZE_LATENCY: Attempt to set stream parameters for lowest possible latency.
     - \e RTAUDIO_HOG_DEVICE:       Attempt grab device for exclusive use.
     - \e RTAUDIO_ALSA_USE_DEFAULT: Use the "default" PCM device (ALSA only).
+    - \e RTAUDIO_ALSA_MMAP:        Capture through the mmap'd device buffer (ALSA only).
 
     By default, RtAudio streams pass and receive audio data from the
     client in an interleaved format.  By passing the
@@ -118,6 +120,11 @@ static const RtAudioFormat RTAUDIO_FLOAT64 = 0x20; // Normalized between plus/mi
     If the RTAUDIO_ALSA_USE_DEFAULT flag is set, RtAudio will attempt to
     open the "default" PCM device when using the ALSA API. Note that this
     will override any specified input or output device id.
+
+    If the RTAUDIO_ALSA_MMAP flag is set, ALSA input is read with
+    snd_pcm_mmap_begin()/snd_pcm_mmap_commit() and converted straight
+    from the device's DMA area into the user buffer, saving a copy per
+    buffer.  Devices without mmap access fall back to read/write access.
 */
 typedef unsigned int RtAudioStreamFlags;
 static const RtAudioStreamFlags RTAUDIO_NONINTERLEAVED = 0x1;    // Use non-interleaved buffers (default = interleaved).
@@ -125,6 +132,7 @@ static const RtAudioStreamFlags RTAUDIO_MINIMIZE_LATENCY = 0x2;  // Attempt to s
 static const RtAudioStreamFlags RTAUDIO_HOG_DEVICE = 0x4;        // Attempt grab device and prevent use by others.
 static const RtAudioStreamFlags RTAUDIO_SCHEDULE_REALTIME = 0x8; // Try to select realtime scheduling for callback thread.
 static const RtAudioStreamFlags RTAUDIO_ALSA_USE_DEFAULT = 0x10; // Use the "default" PCM device (ALSA only).
+static const RtAudioStreamFlags RTAUDIO_ALSA_MMAP = 0x20;        // Capture via the mmap'd device buffer (ALSA only).
 
 /*! \typedef typedef unsigned long RtAudioStreamStatus;
     \brief RtAudio stream status (over- or underflow) flags.
@@ -141,6 +149,9 @@ typedef unsigned int RtAudioStreamStatus;
 static const RtAudioStreamStatus RTAUDIO_INPUT_OVERFLOW = 0x1;    // Input data was discarded because of an overflow condition at the driver.
 static const RtAudioStreamStatus RTAUDIO_OUTPUT_UNDERFLOW = 0x2;  // The output buffer ran low, likely causing a gap in the output sound.
 
+//! Number of callback duration buckets in RtAudio::StreamStats (log2 microseconds, up to about half a second).
+static const unsigned int RTAUDIO_STATS_BUCKETS = 20;
+
 //! RtAudio callback function prototype.
 /*!
    All RtAudio clients must create a function of type RtAudioCallback
@@ -257,6 +268,7 @@ class RtAudio
     - \e RTAUDIO_HOG_DEVICE:        Attempt grab device for exclusive use.
     - \e RTAUDIO_SCHEDULE_REALTIME: Attempt to select realtime scheduling for callback thread.
     - \e RTAUDIO_ALSA_USE_DEFAULT:  Use the "default" PCM device (ALSA only).
+    - \e RTAUDIO_ALSA_MMAP:         Capture through the mmap'd device buffer (ALSA only).
 
     By default, RtAudio streams pass and receive audio data from the
     client in an interleaved format.  By passing the
@@ -291,6 +303,11 @@ class RtAudio
     open the "default" PCM device when using the ALSA API. Note that this
     will override any specified input or output device id.
 
+    If the RTAUDIO_ALSA_MMAP flag is set, ALSA input is read with
+    snd_pcm_mmap_begin()/snd_pcm_mmap_commit() and converted straight
+    from the device's DMA area into the user buffer, saving a copy per
+    buffer.  Devices without mmap access fall back to read/write access.
+
     The \c numberOfBuffers parameter can be used to control stream
     latency in the Windows DirectSound, Linux OSS, and Linux Alsa APIs
     only.  A value of two is usually the smallest allowed.  Larger
@@ -315,6 +332,36 @@ class RtAudio
     : flags(0), numberOfBuffers(0), priority(0) {}
   };
 
+  //! Cumulative xrun and callback timing counts for a stream.
+  /*!
+    The counts start at zero when a stream is opened and survive
+    closeStream(), so they can be read after the fact.  Overflows and
+    underflows count the callbacks that were handed the
+    RTAUDIO_INPUT_OVERFLOW or RTAUDIO_OUTPUT_UNDERFLOW status, which is
+    one per recovery by the driver.  A callback overrun is a callback
+    that took longer than one buffer period (\c periodSeconds) to
+    return; enough of them and the stream falls behind the device.
+    Bucket \c k of \c callbackHistogram counts callbacks that took
+    between 2^k and 2^(k+1) microseconds; the first bucket also holds
+    anything quicker and the last anything slower.
+  */
+  struct StreamStats {
+    unsigned long callbacks;        /*!< Callbacks made. */
+    unsigned long inputOverflows;   /*!< Callbacks flagged RTAUDIO_INPUT_OVERFLOW. */
+    unsigned long outputUnderflows; /*!< Callbacks flagged RTAUDIO_OUTPUT_UNDERFLOW. */
+    unsigned long callbackOverruns; /*!< Callbacks that took longer than one buffer period. */
+    double periodSeconds;           /*!< One buffer period (buffer frames / sample rate), 0 before the first open. */
+    double callbackSeconds;         /*!< Total time spent in the callback. */
+    double callbackMaxSeconds;      /*!< Longest callback. */
+    unsigned long callbackHistogram[RTAUDIO_STATS_BUCKETS]; /*!< Callback durations in log2 microsecond buckets. */
+
+    // Default constructor.
+    StreamStats()
+    : callbacks(0), inputOverflows(0), outputUnderflows(0), callbackOverruns(0),
+      periodSeconds(0), callbackSeconds(0), callbackMaxSeconds(0)
+    { for ( unsigned int k=0; k<RTAUDIO_STATS_BUCKETS; k++ ) callbackHistogram[k] = 0; }
+  };
+
   //! A static function to determine the available compiled audio APIs.
   /*!
     The values returned in the std::vector can be compared against
@@ -494,6 +541,17 @@ class RtAudio
  */
   unsigned int getStreamSampleRate( void );
 
+  //! Returns the xrun and callback timing counts of the open (or last) stream.
+  /*!
+    This function may be called from any thread while the stream runs,
+    e.g. to poll for dropouts.  Each count is read atomically, though
+    two counts may be a callback apart.
+  */
+  StreamStats getStreamStats( void );
+
+  //! Zeroes the counts returned by getStreamStats().
+  void resetStreamStats( void );
+
   //! Specify whether warning messages should be printed to stderr.
   void showWarnings( bool value = true ) throw();
 
@@ -584,6 +642,8 @@ public:
   virtual void abortStream( void ) = 0;
   long getStreamLatency( void );
   unsigned int getStreamSampleRate( void );
+  RtAudio::StreamStats getStreamStats( void );
+  void resetStreamStats( void );
   virtual double getStreamTime( void );
   bool isStreamOpen( void ) const { return stream_.state != STREAM_CLOSED; };
   bool isStreamRunning( void ) const { return stream_.state == STREAM_RUNNING; };
@@ -663,6 +723,20 @@ protected:
   bool showWarnings_;
   RtApiStream stream_;
 
+  // Counters behind getStreamStats(): written by the callback thread
+  // (relaxed atomic adds), read from any other.
+  struct StreamCounters {
+    std::atomic<unsigned long> callbacks;
+    std::atomic<unsigned long> inputOverflows;
+    std::atomic<unsigned long> outputUnderflows;
+    std::atomic<unsigned long> callbackOverruns;
+    std::atomic<unsigned long long> callbackNs;
+    std::atomic<unsigned long long> callbackMaxNs;
+    std::atomic<unsigned long> callbackHistogram[RTAUDIO_STATS_BUCKETS];
+    double periodSeconds;  // set when the stream opens, before any callback
+  };
+  StreamCounters counters_;
+
   /*!
     Protected, api-specific method that attempts to open a device
     with the given parameters.  This function MUST be implemented by
@@ -678,6 +752,14 @@ protected:
   //! A protected function used to increment the stream time.
   void tickStreamTime( void );
 
+  /*!
+    Protected method that invokes the user callback on the stream
+    buffers with the given \c status, counting the status and the
+    callback's duration into the stream stats.  Returns the callback's
+    return value.
+  */
+  int runCallback( RtAudioStreamStatus status );
+
   //! Protected common method to clear an RtApiStream structure.
   void clearStreamInfo();
 
@@ -696,9 +778,21 @@ protected:
   */
   void convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info );
 
+  //! Same, for the first \c frames frames only (at most the buffer size).
+  void convertBuffer( char *outBuffer, char *inBuffer, ConvertInfo &info, unsigned int frames );
+
+  //! Vectorized convertBuffer() for the common formats and layouts; false if not handled.
+  bool convertBufferFast( char *outBuffer, char *inBuffer, ConvertInfo &info, unsigned int frames );
+
+  //! The scalar loops behind convertBuffer(), for every format; convertBufferFast() must match them.
+  void convertBufferGeneric( char *outBuffer, char *inBuffer, ConvertInfo &info, unsigned int frames );
+
   //! Protected common method used to perform byte-swapping on buffers.
   void byteSwapBuffer( char *buffer, unsigned int samples, RtAudioFormat format );
 
+  //! The scalar loops behind byteSwapBuffer(); its vector path must match them.
+  void byteSwapBufferGeneric( char *buffer, unsigned int samples, RtAudioFormat format );
+
   //! Protected common method that returns the number of bytes for a given format.
   unsigned int formatBytes( RtAudioFormat format );
 
@@ -725,6 +819,8 @@ inline bool RtAudio :: isStreamOpen( void ) const throw() { return rtapi_->isStr
 inline bool RtAudio :: isStreamRunning( void ) const throw() { return rtapi_->isStreamRunning(); }
 inline long RtAudio :: getStreamLatency( void ) { return rtapi_->getStreamLatency(); }
 inline unsigned int RtAudio :: getStreamSampleRate( void ) { return rtapi_->getStreamSampleRate(); };
+inline RtAudio::StreamStats RtAudio :: getStreamStats( void ) { return rtapi_->getStreamStats(); }
+inline void RtAudio :: resetStreamStats( void ) { rtapi_->resetStreamStats(); }
 inline double RtAudio :: getStreamTime( void ) { return rtapi_->getStreamTime(); }
 inline void RtAudio :: showWarnings( bool value ) throw() { rtapi_->showWarnings( value ); }
 
@@ -902,11 +998,17 @@ public:
   private:
 
   std::vector<RtAudio::DeviceInfo> devices_;
+  // mmap capture: device-to-user conversion addressed by the channel
+  // areas, built on the first snd_pcm_mmap_begin()
+  ConvertInfo mmapConvert_;
+  bool mmapConvertReady_;
+  unsigned int mmapFirstChannel_;
   void saveDeviceInfo( void );
   bool probeDeviceOpen( unsigned int device, StreamMode mode, unsigned int channels, 
                         unsigned int firstChannel, unsigned int sampleRate,
                         RtAudioFormat format, unsigned int *bufferSize,
                         RtAudio::StreamOptions *options );
+  int captureMmap( void );
 };
 
 #endif
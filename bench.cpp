@@ -0,0 +1,659 @@
+//-----------------------------------------------------------------------------
+// name: bench.cpp
+// desc: benchmark suite for the analysis and simulation hot paths
+//
+//   builds ColorfulMusic.cpp without its main() and times the same code
+//   the app runs: rfft per size and kernel, window_copy(), pushFftBuf() and
+//   spectrum_compress() per curve, computeAmplitudeAndFrequency(),
+//   XStft::feed() + transform() per channel count, serial and pooled,
+//   RtApi::convertBuffer() per format and layout (vectorized and generic),
+//   RtApi::byteSwapBuffer() per format (vectorized and generic),
+//   ParticleEngine::step() and the render prep (tilt + depth sort) per
+//   particle count.  each case is
+//   calibrated so one sample takes at least BENCH_MIN_SAMPLE_NS, then
+//   timed for --samples samples; results go out as JSON (ns per op,
+//   mean/min/percentiles over the samples).
+//
+//   usage: bench [--samples=N] [--threads=N] [--filter=TEXT] [--out=FILE]
+//          bench --verify
+//
+//   --verify checks convertBuffer() and byteSwapBuffer() against their
+//   generic loops and every fft kernel against the scalar one instead of
+//   timing anything, and exits non-zero on any difference.
+//-----------------------------------------------------------------------------
+#define __COLORFULMUSIC_BENCH__
+#include "ColorfulMusic.cpp"
+#include <stdio.h>
+#include <vector>
+
+// shortest sample worth timing
+#define BENCH_MIN_SAMPLE_NS 200000.0
+
+// samples per case
+long g_benchSamples = 101;
+// only cases whose name contains this
+const char * g_benchFilter = NULL;
+// JSON goes here
+FILE * g_benchOut = stdout;
+// cases written so far (for the separators)
+long g_benchCases = 0;
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: benchNow()
+// desc: monotonic nanoseconds
+//-----------------------------------------------------------------------------
+static double benchNow()
+{
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: benchPercentile()
+// desc: nearest-rank percentile of sorted values
+//-----------------------------------------------------------------------------
+static double benchPercentile( const std::vector<double> & sorted, double p )
+{
+    long k = (long)ceil( p / 100.0 * sorted.size() ) - 1;
+    if( k < 0 ) k = 0;
+    return sorted[k];
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: benchCase()
+// desc: calibrate, sample and report one case; params is a JSON fragment
+//       ("key": value, ...) describing it
+//-----------------------------------------------------------------------------
+template <class Op>
+static void benchCase( const char * name, const char * params, Op op )
+{
+    if( g_benchFilter && !strstr( name, g_benchFilter ) )
+        return;
+
+    // warm up, then double the batch until one sample is long enough
+    op();
+    long reps = 1;
+    for( ;; )
+    {
+        double t0 = benchNow();
+        for( long r = 0; r < reps; r++ ) op();
+        if( benchNow() - t0 >= BENCH_MIN_SAMPLE_NS || reps >= (1L << 24) )
+            break;
+        reps *= 2;
+    }
+
+    std::vector<double> ns( g_benchSamples );
+    double sum = 0;
+    for( long s = 0; s < g_benchSamples; s++ )
+    {
+        double t0 = benchNow();
+        for( long r = 0; r < reps; r++ ) op();
+        ns[s] = (benchNow() - t0) / reps;
+        sum += ns[s];
+    }
+    sort( ns.begin(), ns.end() );
+
+    fprintf( g_benchOut, "%s    { \"name\": \"%s\", %s, \"ops_per_sample\": %ld, "
+             "\"samples\": %ld, \"ns_per_op\": %.1f, \"min\": %.1f, \"p50\": %.1f, "
+             "\"p90\": %.1f, \"p99\": %.1f, \"max\": %.1f }",
+             g_benchCases ? ",\n" : "", name, params, reps, g_benchSamples,
+             sum / g_benchSamples, ns[0], benchPercentile( ns, 50 ),
+             benchPercentile( ns, 90 ), benchPercentile( ns, 99 ), ns.back() );
+    fflush( g_benchOut );
+    g_benchCases++;
+    cerr << "[bench] " << name << " " << params << ": "
+         << sum / g_benchSamples << " ns/op" << endl;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: benchFft()
+// desc: rfft at 256..65536 reals, through the unplanned entry point and
+//       through a plan per available kernel; each op restores the input
+//       first (a copy of size floats) so values stay bounded
+//-----------------------------------------------------------------------------
+static void benchFft()
+{
+    char params[256];
+    for( long size = 256; size <= 65536; size *= 2 )
+    {
+        std::vector<float> input( size ), x( size );
+        XRandom rng( size );
+        rng.fill( &input[0], size, -1, 1 );
+
+        snprintf( params, sizeof(params), "\"size\": %ld", size );
+        benchCase( "rfft", params, [&]() {
+            memcpy( &x[0], &input[0], sizeof(float) * size );
+            rfft( &x[0], size / 2, FFT_FORWARD );
+        } );
+
+        for( int kernel = FFT_KERNEL_SCALAR; kernel <= FFT_KERNEL_AVX; kernel++ )
+        {
+            fft_plan * plan = fft_plan_create_kernel( size / 2, kernel );
+            // skip kernels this cpu lacks (the plan fell back)
+            if( plan && fft_plan_kernel( plan ) == kernel )
+            {
+                snprintf( params, sizeof(params), "\"size\": %ld, \"kernel\": \"%s\"",
+                          size, fft_kernel_name( kernel ) );
+                benchCase( "fft_plan_rfft", params, [&]() {
+                    memcpy( &x[0], &input[0], sizeof(float) * size );
+                    fft_plan_rfft( plan, &x[0], FFT_FORWARD );
+                } );
+            }
+            fft_plan_destroy( plan );
+        }
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: benchAnalysis()
+// desc: stft windowing, history push and peak search per fft size
+//-----------------------------------------------------------------------------
+static void benchAnalysis()
+{
+    char params[256];
+    for( long size = 512; size <= 16384; size *= 4 )
+    {
+        g_windowSize = size;
+        initializeFftBufs();
+        std::vector<float> spectrum( size );
+        XRandom rng( size );
+        rng.fill( &spectrum[0], size, -0.5, 0.5 );
+        complex * current = (complex *)&spectrum[0];
+
+        snprintf( params, sizeof(params), "\"size\": %ld", size );
+        benchCase( "pushFftBuf", params, [&]() {
+            pushFftBuf( current );
+        } );
+        benchCase( "computeAmplitudeAndFrequency", params, [&]() {
+            computeAmplitudeAndFrequency();
+        } );
+
+        // windowed copy out of the stft history, starting mid-ring so
+        // both runs are exercised (the cost does not depend on the shape)
+        std::vector<float> frame( size );
+        const float * window = window_cached( WINDOW_HANN, size, 0 );
+        benchCase( "window_copy", params, [&]() {
+            window_copy( &frame[0], &spectrum[0], size, size / 3, window, size );
+        } );
+
+        // each magnitude curve on its own (pushFftBuf uses the default)
+        static const char * curves[] = { "sqrt", "cbrt", "log" };
+        std::vector<float> out( size / 2 );
+        for( int c = SPECTRUM_SQRT; c <= SPECTRUM_LOG10; c++ )
+        {
+            snprintf( params, sizeof(params), "\"bins\": %ld, \"curve\": \"%s\"",
+                      size / 2, curves[c] );
+            benchCase( "spectrum_compress", params, [&]() {
+                spectrum_compress( current, &out[0], size / 2, c, 30, 1e-3f );
+            } );
+        }
+    }
+
+    // one redraw's worth of multichannel analysis (a 1024-frame block,
+    // four hops), on the calling thread and across the pool; where the
+    // pool starts winning sets XSTFT_PARALLEL_CHANNELS
+    for( long channels = 1; channels <= 32; channels *= 2 )
+    {
+        XStft stft;
+        stft.init( 1024, 256, 1024, 8, WINDOW_HANN, 0, channels );
+        std::vector<float> block( 1024 * channels );
+        XRandom rng( channels );
+        rng.fill( &block[0], block.size(), -0.5, 0.5 );
+        for( int pooled = 0; pooled < 2; pooled++ )
+        {
+            snprintf( params, sizeof(params), "\"channels\": %ld, \"frames\": 4, "
+                      "\"threads\": %d", channels, pooled ? g_workPool.numWorkers() : 1 );
+            benchCase( "XStft::transform", params, [&]() {
+                stft.clear();
+                stft.feed( &block[0], 1024 );
+                // pooled means the pool whatever the channel count
+                stft.transform( pooled ? &g_workPool : NULL, 0 );
+            } );
+        }
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: class BenchApi
+// desc: an RtApi with no devices, to reach the stream buffer conversion
+//-----------------------------------------------------------------------------
+class BenchApi : public RtApi
+{
+public:
+    BenchApi() : m_info( NULL ) { }
+    RtAudio::Api getCurrentApi() { return RtAudio::RTAUDIO_DUMMY; }
+    unsigned int getDeviceCount() { return 0; }
+    RtAudio::DeviceInfo getDeviceInfo( unsigned int ) { return RtAudio::DeviceInfo(); }
+    void startStream() { }
+    void stopStream() { }
+    void abortStream() { }
+
+public:
+    // an input stream: device side in format, interleaved or not, user
+    // side float32 interleaved (what the capture callback asks for)
+    void configure( RtAudioFormat format, bool interleaved, unsigned int channels,
+                    unsigned int frames )
+    { configure( true, RTAUDIO_FLOAT32, format, true, interleaved, channels, 0, frames ); }
+    // any one-way stream: input converts device to user buffer, output
+    // user to device; the device has firstChannel channels in front
+    void configure( bool input, RtAudioFormat userFormat, RtAudioFormat deviceFormat,
+                    bool userInterleaved, bool deviceInterleaved, unsigned int channels,
+                    unsigned int firstChannel, unsigned int frames )
+    {
+        StreamMode mode = input ? INPUT : OUTPUT;
+        stream_.mode = mode;
+        stream_.bufferSize = frames;
+        stream_.nUserChannels[mode] = channels;
+        stream_.nDeviceChannels[mode] = channels + firstChannel;
+        stream_.userFormat = userFormat;
+        stream_.deviceFormat[mode] = deviceFormat;
+        stream_.userInterleaved = userInterleaved;
+        stream_.deviceInterleaved[mode] = deviceInterleaved;
+        m_info = &stream_.convertInfo[mode];
+        m_info->inOffset.clear();
+        m_info->outOffset.clear();
+        setConvertInfo( mode, firstChannel );
+
+        // room for every device channel either way
+        size_t samples = (channels + firstChannel) * frames;
+        m_in.assign( samples * formatBytes( m_info->inFormat ), 0 );
+        m_out.assign( samples * formatBytes( m_info->outFormat ), 0 );
+        m_ref.assign( m_out.size(), 0 );
+        // integers take any bits; floats stay finite and in range
+        XRandom rng( samples );
+        if( m_info->inFormat == RTAUDIO_FLOAT32 )
+            rng.fill( (float *)&m_in[0], samples, -1, 1 );
+        else if( m_info->inFormat == RTAUDIO_FLOAT64 )
+            for( size_t i = 0; i < samples; i++ )
+                ((double *)&m_in[0])[i] = 2 * rng.nextd() - 1;
+        else
+            for( size_t i = 0; i < m_in.size(); i++ )
+                m_in[i] = (char)(rng.next() >> 24);
+    }
+    void convert() { convertBuffer( &m_out[0], &m_in[0], *m_info ); }
+    void convertGeneric()
+    { convertBufferGeneric( &m_out[0], &m_in[0], *m_info, stream_.bufferSize ); }
+    // convertBuffer() and convertBufferGeneric() over the first frames
+    // frames, from the same starting bytes; true if they agree exactly
+    bool check( unsigned int frames )
+    {
+        memset( &m_out[0], 0xa5, m_out.size() );
+        memset( &m_ref[0], 0xa5, m_ref.size() );
+        convertBuffer( &m_out[0], &m_in[0], *m_info, frames );
+        convertBufferGeneric( &m_ref[0], &m_in[0], *m_info, frames );
+        return !memcmp( &m_out[0], &m_ref[0], m_out.size() );
+    }
+    // in place, so the buffer flips back and forth
+    void swap() { byteSwapBuffer( &m_in[0], m_in.size() / formatBytes( m_info->inFormat ),
+                                  m_info->inFormat ); }
+    void swapGeneric()
+    { byteSwapBufferGeneric( &m_in[0], m_in.size() / formatBytes( m_info->inFormat ),
+                             m_info->inFormat ); }
+    // byteSwapBuffer() and byteSwapBufferGeneric() on copies of the same
+    // bytes, samples samples from offset bytes in; true if they agree
+    bool checkSwap( RtAudioFormat format, unsigned int samples, unsigned int offset )
+    {
+        size_t bytes = offset + samples * formatBytes( format ) + 16;
+        m_out.resize( bytes );
+        m_ref.resize( bytes );
+        XRandom rng( samples * 4 + offset );
+        for( size_t i = 0; i < bytes; i++ )
+            m_out[i] = m_ref[i] = (char)(rng.next() >> 24);
+        byteSwapBuffer( &m_out[offset], samples, format );
+        byteSwapBufferGeneric( &m_ref[offset], samples, format );
+        return !memcmp( &m_out[0], &m_ref[0], bytes );
+    }
+
+private:
+    std::vector<char> m_in, m_out, m_ref;
+    ConvertInfo * m_info;
+};
+
+
+
+
+// names for the bench params and --verify reports
+static const char * benchFormatName( RtAudioFormat format )
+{
+    switch( format )
+    {
+        case RTAUDIO_SINT8: return "s8";
+        case RTAUDIO_SINT16: return "s16";
+        case RTAUDIO_SINT24: return "s24";
+        case RTAUDIO_SINT32: return "s32";
+        case RTAUDIO_FLOAT32: return "f32";
+        default: return "f64";
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: benchAudio()
+// desc: device to user buffer conversion of one capture period, and byte
+//       swapping of a wide one
+//-----------------------------------------------------------------------------
+static void benchAudio()
+{
+    static const RtAudioFormat formats[] = { RTAUDIO_SINT16, RTAUDIO_SINT24,
+                                             RTAUDIO_SINT32, RTAUDIO_FLOAT32 };
+    static const unsigned int channels[] = { 2, 8 };
+    const unsigned int frames = 512;
+    char params[256];
+    BenchApi api;
+
+    for( int f = 0; f < 4; f++ )
+        for( int c = 0; c < 2; c++ )
+            for( int il = 1; il >= 0; il-- )
+            {
+                // float32 interleaved to itself needs no conversion
+                if( formats[f] == RTAUDIO_FLOAT32 && il ) continue;
+                api.configure( formats[f], il, channels[c], frames );
+                // the vectorized path and the generic loops it replaces
+                for( int generic = 0; generic < 2; generic++ )
+                {
+                    snprintf( params, sizeof(params), "\"frames\": %u, \"channels\": %u, "
+                              "\"format\": \"%s\", \"layout\": \"%s\", \"path\": \"%s\"",
+                              frames, channels[c], benchFormatName( formats[f] ),
+                              il ? "interleaved" : "planar", generic ? "generic" : "fast" );
+                    benchCase( "convertBuffer", params, [&]() {
+                        if( generic ) api.convertGeneric();
+                        else api.convert();
+                    } );
+                }
+            }
+
+    // a wide capture block (32 channels of 4096 frames) from a device of
+    // the other endianness, per format, vectorized and generic
+    static const RtAudioFormat swapFormats[] = { RTAUDIO_SINT16, RTAUDIO_SINT24,
+                                                 RTAUDIO_SINT32, RTAUDIO_FLOAT32,
+                                                 RTAUDIO_FLOAT64 };
+    for( int f = 0; f < 5; f++ )
+    {
+        api.configure( swapFormats[f], true, 32, 4096 );
+        for( int generic = 0; generic < 2; generic++ )
+        {
+            snprintf( params, sizeof(params), "\"frames\": 4096, \"channels\": 32, "
+                      "\"format\": \"%s\", \"path\": \"%s\"",
+                      benchFormatName( swapFormats[f] ), generic ? "generic" : "fast" );
+            benchCase( "byteSwapBuffer", params, [&]() {
+                if( generic ) api.swapGeneric();
+                else api.swap();
+            } );
+        }
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: verifyConvert()
+// desc: convertBuffer() against convertBufferGeneric() for every format
+//       pair, direction, layout, channel count, first channel and a spread
+//       of odd frame counts; reports and counts every mismatch
+//-----------------------------------------------------------------------------
+static bool verifyConvert()
+{
+    static const RtAudioFormat formats[] = { RTAUDIO_SINT8, RTAUDIO_SINT16,
+                                             RTAUDIO_SINT24, RTAUDIO_SINT32,
+                                             RTAUDIO_FLOAT32, RTAUDIO_FLOAT64 };
+    static const unsigned int channels[] = { 1, 2, 3, 5, 8 };
+    static const unsigned int firstChannels[] = { 0, 1, 3 };
+    // up to and including a whole (odd) buffer
+    static const unsigned int frames[] = { 1, 3, 7, 33, 257 };
+    const unsigned int bufferFrames = 257;
+    long cases = 0, failed = 0;
+    BenchApi api;
+
+    for( int input = 0; input < 2; input++ )
+    for( int uf = 0; uf < 6; uf++ )
+    for( int df = 0; df < 6; df++ )
+    for( int ui = 0; ui < 2; ui++ )
+    for( int di = 0; di < 2; di++ )
+    for( int c = 0; c < 5; c++ )
+    for( int fc = 0; fc < 3; fc++ )
+    {
+        api.configure( input, formats[uf], formats[df], ui, di, channels[c],
+                       firstChannels[fc], bufferFrames );
+        for( int n = 0; n < 5; n++ )
+        {
+            cases++;
+            if( api.check( frames[n] ) ) continue;
+            failed++;
+            fprintf( stderr, "convertBuffer mismatch: %s, user %s %s, device %s %s, "
+                     "%u channels from %u, %u frames\n", input ? "input" : "output",
+                     benchFormatName( formats[uf] ), ui ? "interleaved" : "planar",
+                     benchFormatName( formats[df] ), di ? "interleaved" : "planar",
+                     channels[c], firstChannels[fc], frames[n] );
+        }
+    }
+
+    fprintf( stderr, "convertBuffer: %ld cases, %ld mismatches\n", cases, failed );
+    return failed == 0;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: verifySwap()
+// desc: byteSwapBuffer() against byteSwapBufferGeneric() for every format,
+//       every sample count up to a few vectors and every misalignment
+//-----------------------------------------------------------------------------
+static bool verifySwap()
+{
+    static const RtAudioFormat formats[] = { RTAUDIO_SINT8, RTAUDIO_SINT16,
+                                             RTAUDIO_SINT24, RTAUDIO_SINT32,
+                                             RTAUDIO_FLOAT32, RTAUDIO_FLOAT64 };
+    long cases = 0, failed = 0;
+    BenchApi api;
+
+    for( int f = 0; f < 6; f++ )
+    for( unsigned int samples = 0; samples <= 67; samples++ )
+    for( unsigned int offset = 0; offset < 16; offset++ )
+    {
+        cases++;
+        if( api.checkSwap( formats[f], samples, offset ) ) continue;
+        failed++;
+        fprintf( stderr, "byteSwapBuffer mismatch: %s, %u samples at offset %u\n",
+                 benchFormatName( formats[f] ), samples, offset );
+    }
+
+    fprintf( stderr, "byteSwapBuffer: %ld cases, %ld mismatches\n", cases, failed );
+    return failed == 0;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: verifyFft()
+// desc: every fft kernel the cpu supports against FFT_KERNEL_SCALAR: rfft
+//       and cfft, forward and inverse, single frames and a batch, at every
+//       size from 2 to 32768 floats; the kernels order their arithmetic
+//       differently, so outputs must agree to within FFT_VERIFY_TOLERANCE
+//       of the largest reference output
+//-----------------------------------------------------------------------------
+#define FFT_VERIFY_TOLERANCE 1e-5
+
+static bool verifyFft()
+{
+    static const long counts[] = { 1, 3 };
+    long cases = 0, failed = 0;
+    double worst = 0;
+
+    for( long N = 1; N <= 16384; N *= 2 )
+    {
+        fft_plan * scalar = fft_plan_create_kernel( N, FFT_KERNEL_SCALAR );
+        for( int kernel = FFT_KERNEL_RADIX4; kernel <= FFT_KERNEL_AVX; kernel++ )
+        {
+            fft_plan * plan = fft_plan_create_kernel( N, kernel );
+            // skip kernels this cpu lacks (the plan fell back)
+            if( scalar && plan && fft_plan_kernel( plan ) == kernel )
+            for( int complex = 0; complex < 2; complex++ )
+            for( int forward = 0; forward < 2; forward++ )
+            for( int c = 0; c < 2; c++ )
+            {
+                long size = 2 * N * counts[c];
+                std::vector<float> want( size ), got( size );
+                XRandom rng( N * 8 + complex * 4 + forward * 2 + c );
+                rng.fill( &want[0], size, -1, 1 );
+                got = want;
+                if( complex )
+                {
+                    fft_plan_cfft_batch( scalar, &want[0], counts[c], forward );
+                    fft_plan_cfft_batch( plan, &got[0], counts[c], forward );
+                }
+                else
+                {
+                    fft_plan_rfft_batch( scalar, &want[0], counts[c], forward );
+                    fft_plan_rfft_batch( plan, &got[0], counts[c], forward );
+                }
+
+                double peak = 0, error = 0;
+                for( long i = 0; i < size; i++ )
+                {
+                    peak = max( peak, (double)fabs( want[i] ) );
+                    error = max( error, (double)fabs( got[i] - want[i] ) );
+                }
+                double relative = peak > 0 ? error / peak : error;
+                worst = max( worst, relative );
+                cases++;
+                if( relative <= FFT_VERIFY_TOLERANCE ) continue;
+                failed++;
+                fprintf( stderr, "fft mismatch: %s, %s %s, %ld floats x %ld, "
+                         "error %g of peak %g\n", fft_kernel_name( kernel ),
+                         complex ? "cfft" : "rfft", forward ? "forward" : "inverse",
+                         2 * N, counts[c], error, peak );
+            }
+            fft_plan_destroy( plan );
+        }
+        fft_plan_destroy( scalar );
+    }
+
+    fprintf( stderr, "fft kernels: %ld cases, %ld mismatches (worst error %g)\n",
+             cases, failed, worst );
+    return failed == 0;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: benchParticles()
+// desc: one simulation step and one render prep per particle count
+//-----------------------------------------------------------------------------
+static void benchParticles()
+{
+    static const int counts[] = { 1000, 10000, 100000, MAX_PARTICLES };
+    char params[256];
+    ParticleEngine * engine = new ParticleEngine();
+
+    for( size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++ )
+    {
+        int n = counts[c];
+        NUM_PARTICLES = n;
+        for( int spiral = 0; spiral < 2; spiral++ )
+        {
+            isSpiral = spiral;
+            snprintf( params, sizeof(params), "\"particles\": %d, \"mode\": \"%s\", "
+                      "\"threads\": %d", n, spiral ? "spiral" : "normal",
+                      g_workPool.numWorkers() );
+            benchCase( "ParticleEngine::step", params, [&]() {
+                engine->step();
+            } );
+        }
+        isSpiral = false;
+
+        snprintf( params, sizeof(params), "\"particles\": %d", n );
+        benchCase( "ParticleEngine::prepare", params, [&]() {
+            engine->prepare( n );
+        } );
+    }
+
+    delete engine;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: main()
+// desc: entry point
+//-----------------------------------------------------------------------------
+int main( int argc, char ** argv )
+{
+    int numThreads = 0;
+    bool verify = false;
+    for( int i = 1; i < argc; i++ )
+    {
+        if( !strncmp( argv[i], "--samples=", 10 ) )
+            g_benchSamples = max( 1L, atol( argv[i] + 10 ) );
+        else if( !strncmp( argv[i], "--threads=", 10 ) )
+            numThreads = atoi( argv[i] + 10 );
+        else if( !strcmp( argv[i], "--verify" ) )
+            verify = true;
+        else if( !strncmp( argv[i], "--filter=", 9 ) )
+            g_benchFilter = argv[i] + 9;
+        else if( !strncmp( argv[i], "--out=", 6 ) )
+        {
+            g_benchOut = fopen( argv[i] + 6, "w" );
+            if( !g_benchOut )
+            {
+                cerr << "cannot write " << argv[i] + 6 << endl;
+                return 1;
+            }
+        }
+        else
+        {
+            cerr << "usage: bench [--samples=N] [--threads=N] [--filter=TEXT] [--out=FILE]" << endl;
+            cerr << "       bench --verify" << endl;
+            return 1;
+        }
+    }
+
+    // the vectorized paths against their scalar references, no timing
+    if( verify )
+    {
+        bool ok = verifyConvert();
+        ok = verifySwap() && ok;
+        ok = verifyFft() && ok;
+        return ok ? 0 : 1;
+    }
+
+    // same seed as the app's default, so every run does the same work
+    XFun::srand( g_seed );
+    g_workPool.init( numThreads );
+
+    fprintf( g_benchOut, "{\n  \"suite\": \"ColorfulMusic\",\n  \"threads\": %d,\n"
+             "  \"samples\": %ld,\n  \"cases\": [\n",
+             g_workPool.numWorkers(), g_benchSamples );
+    benchFft();
+    benchAnalysis();
+    benchAudio();
+    benchParticles();
+    fprintf( g_benchOut, "\n  ]\n}\n" );
+
+    if( g_benchOut != stdout ) fclose( g_benchOut );
+    return 0;
+}
@@ -10,69 +10,133 @@
 #include "chuck_fft.h"
 #include <stdlib.h>
 #include <math.h>
+#include <float.h>
+
+// x86 simd kernels are compiled per-function and picked at runtime
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#define __CHUCK_FFT_X86__
+#include <immintrin.h>
+#endif
 
 
 
 
 //-----------------------------------------------------------------------------
-// name: hanning()
-// desc: make window
+// name: cosine_window()
+// desc: periodic sum-of-cosines window, w[i] = sum_k (-1)^k a[k] cos(k phase);
+//       the phase comes from the index, so there is no accumulated drift
 //-----------------------------------------------------------------------------
-void hanning( float * window, unsigned long length )
+static void cosine_window( float * window, unsigned long length,
+                           const double * a, int terms )
 {
     unsigned long i;
-    double pi, phase = 0, delta;
+    int k;
+    double pi, delta, phase, sum;
 
     pi = 4.*atan(1.0);
     delta = 2 * pi / (double) length;
 
     for( i = 0; i < length; i++ )
     {
-        window[i] = (float)(0.5 * (1.0 - cos(phase)));
-        phase += delta;
+        phase = delta * i;
+        sum = a[0];
+        for( k = 1; k < terms; k++ )
+            sum += (k & 1 ? -a[k] : a[k]) * cos( k * phase );
+        window[i] = (float)sum;
     }
 }
 
 
 
 
+//-----------------------------------------------------------------------------
+// name: hanning()
+// desc: make window
+//-----------------------------------------------------------------------------
+void hanning( float * window, unsigned long length )
+{
+    static const double a[] = { 0.5, 0.5 };
+    cosine_window( window, length, a, 2 );
+}
+
+
+
+
 //-----------------------------------------------------------------------------
 // name: hamming()
 // desc: make window
 //-----------------------------------------------------------------------------
 void hamming( float * window, unsigned long length )
 {
-    unsigned long i;
-    double pi, phase = 0, delta;
+    static const double a[] = { 0.54, 0.46 };
+    cosine_window( window, length, a, 2 );
+}
 
-    pi = 4.*atan(1.0);
-    delta = 2 * pi / (double) length;
 
-    for( i = 0; i < length; i++ )
+
+
+//-----------------------------------------------------------------------------
+// name: blackman()
+// desc: make window
+//-----------------------------------------------------------------------------
+void blackman( float * window, unsigned long length )
+{
+    static const double a[] = { 0.42, 0.5, 0.08 };
+    cosine_window( window, length, a, 3 );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: blackman_harris()
+// desc: make window (4-term, minimum sidelobe)
+//-----------------------------------------------------------------------------
+void blackman_harris( float * window, unsigned long length )
+{
+    static const double a[] = { 0.35875, 0.48829, 0.14128, 0.01168 };
+    cosine_window( window, length, a, 4 );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: bessel_i0()
+// desc: modified bessel function of the first kind, order 0 (power series)
+//-----------------------------------------------------------------------------
+static double bessel_i0( double x )
+{
+    double sum = 1, term = 1, q = x * x / 4;
+    int k;
+
+    for( k = 1; k < 200 && term > sum * 1e-17; k++ )
     {
-        window[i] = (float)(0.54 - .46*cos(phase));
-        phase += delta;
+        term *= q / ((double)k * k);
+        sum += term;
     }
+
+    return sum;
 }
 
 
 
+
 //-----------------------------------------------------------------------------
-// name: blackman()
-// desc: make window
+// name: kaiser()
+// desc: make window; periodic like the others, larger beta trades a wider
+//       main lobe for lower sidelobes
 //-----------------------------------------------------------------------------
-void blackman( float * window, unsigned long length )
+void kaiser( float * window, unsigned long length, float beta )
 {
     unsigned long i;
-    double pi, phase = 0, delta;
-
-    pi = 4.*atan(1.0);
-    delta = 2 * pi / (double) length;
+    double r, norm = 1.0 / bessel_i0( beta );
 
     for( i = 0; i < length; i++ )
     {
-        window[i] = (float)(0.42 - .5*cos(phase) + .08*cos(2*phase));
-        phase += delta;
+        // -1 at the first sample, 0 at the centre
+        r = 2.0 * i / (double) length - 1.0;
+        window[i] = (float)(bessel_i0( beta * sqrt( 1.0 - r * r ) ) * norm);
     }
 }
 
@@ -91,12 +155,225 @@ void apply_window( float * data, float * window, unsigned long length )
         data[i] *= window[i];
 }
 
-static float PI ;
-static float TWOPI ;
-void bit_reverse( float * x, long N );
+//-----------------------------------------------------------------------------
+// name: struct fft_plan
+// desc: everything rfft/cfft used to recompute on every call
+//-----------------------------------------------------------------------------
+struct fft_plan
+{
+    // number of complex points (rfft of 2*N reals)
+    long N;
+    // cfft twiddles: exp(i*2pi*k/N), k in [0, N/2), interleaved re/im
+    float * tw;
+    // rfft split twiddles: exp(i*pi*k/N), k in [0, N/2], interleaved re/im
+    float * rtw;
+    // bit-reversal exchanges as pairs of float offsets (i, j), j > i
+    long * swaps;
+    long nswaps;
+    // per-stage twiddles for the radix-2^2 kernels; stage with span h
+    // starts at float 2*(h-1): swr = [c,c,...], swi = [-s,s,...]
+    float * swr;
+    float * swi;
+    // FFT_KERNEL_*
+    int kernel;
+};
+
+
+
+
+static void rfft_split( const fft_plan * plan, float * x, unsigned int forward );
+
+
+
 
 //-----------------------------------------------------------------------------
-// name: rfft()
+// name: fft_kernel_supported()
+// desc: can this cpu run the kernel
+//-----------------------------------------------------------------------------
+static int fft_kernel_supported( int kernel )
+{
+    switch( kernel )
+    {
+        case FFT_KERNEL_SCALAR:
+        case FFT_KERNEL_RADIX4:
+            return 1;
+#ifdef __CHUCK_FFT_X86__
+        case FFT_KERNEL_SSE2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports( "sse2" );
+        case FFT_KERNEL_AVX:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports( "avx" );
+#endif
+        default:
+            return 0;
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_kernel_name()
+// desc: printable kernel name
+//-----------------------------------------------------------------------------
+const char * fft_kernel_name( int kernel )
+{
+    switch( kernel )
+    {
+        case FFT_KERNEL_AUTO: return "auto";
+        case FFT_KERNEL_SCALAR: return "scalar";
+        case FFT_KERNEL_RADIX4: return "radix4";
+        case FFT_KERNEL_SSE2: return "sse2";
+        case FFT_KERNEL_AVX: return "avx";
+        default: return "unknown";
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_plan_create()
+// desc: plan with the best kernel for this cpu
+//-----------------------------------------------------------------------------
+fft_plan * fft_plan_create( long N )
+{
+    return fft_plan_create_kernel( N, FFT_KERNEL_AUTO );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_plan_create_kernel()
+// desc: precompute twiddles (directly, not by recurrence) and bit reversal
+//-----------------------------------------------------------------------------
+fft_plan * fft_plan_create_kernel( long N, int kernel )
+{
+    fft_plan * plan;
+    double pi = 4.*atan(1.0);
+    long k, h, i, j, m, ND, count;
+
+    // must be a power of 2
+    if( N < 1 || (N & (N-1)) ) return NULL;
+
+    // pick the kernel
+    if( kernel == FFT_KERNEL_AUTO )
+    {
+        if( fft_kernel_supported( FFT_KERNEL_AVX ) ) kernel = FFT_KERNEL_AVX;
+        else if( fft_kernel_supported( FFT_KERNEL_SSE2 ) ) kernel = FFT_KERNEL_SSE2;
+        else kernel = FFT_KERNEL_RADIX4;
+    }
+    else if( !fft_kernel_supported( kernel ) )
+        kernel = FFT_KERNEL_RADIX4;
+
+    plan = (fft_plan *)calloc( 1, sizeof(fft_plan) );
+    if( !plan ) return NULL;
+    plan->N = N;
+    plan->kernel = kernel;
+    plan->tw = (float *)malloc( sizeof(float) * 2 * (N/2 + 1) );
+    plan->rtw = (float *)malloc( sizeof(float) * 2 * (N/2 + 1) );
+    plan->swaps = (long *)malloc( sizeof(long) * 2 * (N/2 + 1) );
+    plan->swr = (float *)malloc( sizeof(float) * 2 * N );
+    plan->swi = (float *)malloc( sizeof(float) * 2 * N );
+    if( !plan->tw || !plan->rtw || !plan->swaps || !plan->swr || !plan->swi )
+    {
+        fft_plan_destroy( plan );
+        return NULL;
+    }
+
+    // per-stage tables, contiguous in k so kernels can load them as vectors
+    for( h = 1; h < N; h <<= 1 )
+    {
+        float * wr = plan->swr + 2*(h-1);
+        float * wi = plan->swi + 2*(h-1);
+        for( k = 0; k < h; k++ )
+        {
+            wr[2*k] = wr[2*k+1] = (float)cos( pi * k / h );
+            wi[2*k+1] = (float)sin( pi * k / h );
+            wi[2*k] = -wi[2*k+1];
+        }
+    }
+
+    for( k = 0; k < N/2; k++ )
+    {
+        plan->tw[2*k] = (float)cos( 2 * pi * k / N );
+        plan->tw[2*k+1] = (float)sin( 2 * pi * k / N );
+    }
+    for( k = 0; k <= N/2; k++ )
+    {
+        plan->rtw[2*k] = (float)cos( pi * k / N );
+        plan->rtw[2*k+1] = (float)sin( pi * k / N );
+    }
+
+    // same index walk as the old bit_reverse(), recorded once
+    ND = N<<1;
+    count = 0;
+    for( i = j = 0; i < ND; i += 2, j += m )
+    {
+        if( j > i )
+        {
+            plan->swaps[2*count] = i;
+            plan->swaps[2*count+1] = j;
+            count++;
+        }
+
+        for( m = ND>>1; m >= 2 && j >= m; m >>= 1 )
+            j -= m;
+    }
+    plan->nswaps = count;
+
+    return plan;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_plan_destroy()
+// desc: free a plan
+//-----------------------------------------------------------------------------
+void fft_plan_destroy( fft_plan * plan )
+{
+    if( !plan ) return;
+    free( plan->tw );
+    free( plan->rtw );
+    free( plan->swaps );
+    free( plan->swr );
+    free( plan->swi );
+    free( plan );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_plan_size()
+// desc: N the plan was created for
+//-----------------------------------------------------------------------------
+long fft_plan_size( const fft_plan * plan )
+{
+    return plan ? plan->N : 0;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_plan_kernel()
+// desc: FFT_KERNEL_* used by the plan
+//-----------------------------------------------------------------------------
+int fft_plan_kernel( const fft_plan * plan )
+{
+    return plan ? plan->kernel : FFT_KERNEL_AUTO;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_plan_rfft()
 // desc: real value fft
 //
 //   these routines from the CARL software, spect.c
@@ -109,50 +386,80 @@ void bit_reverse( float * x, long N );
 //   if forward is false, rfft expects x to contain a positive frequency 
 //   spectrum arranged as before, and replaces it with 2*N real values.
 //
-//   N MUST be a power of 2.
+//   N is taken from the plan.
 //
 //-----------------------------------------------------------------------------
-void rfft( float * x, long N, unsigned int forward )
+void fft_plan_rfft( const fft_plan * plan, float * x, unsigned int forward )
 {
-    static int first = 1 ;
-    float c1, c2, h1r, h1i, h2r, h2i, wr, wi, wpr, wpi, temp, theta ;
-    float xr, xi ;
-    long i, i1, i2, i3, i4, N2p1 ;
+    fft_plan_rfft_batch( plan, x, 1, forward ) ;
+}
+
 
-    if( first )
+
+
+//-----------------------------------------------------------------------------
+// name: fft_plan_rfft_batch()
+// desc: rfft of count frames stored back to back (count x 2N floats); the
+//       complex stages for all frames run as one pass per stage pair
+//-----------------------------------------------------------------------------
+void fft_plan_rfft_batch( const fft_plan * plan, float * x, long count,
+                          unsigned int forward )
+{
+    long f, ND = plan->N<<1 ;
+
+    if( forward )
     {
-        PI = (float) (4.*atan( 1. )) ;
-        TWOPI = (float) (8.*atan( 1. )) ;
-        first = 0 ;
+        fft_plan_cfft_batch( plan, x, count, forward ) ;
+        for( f = 0 ; f < count ; f++ )
+            rfft_split( plan, x + f*ND, forward ) ;
     }
+    else
+    {
+        for( f = 0 ; f < count ; f++ )
+            rfft_split( plan, x + f*ND, forward ) ;
+        fft_plan_cfft_batch( plan, x, count, forward ) ;
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: rfft_split()
+// desc: untangle one cfft of N complex into the positive half spectrum of
+//       2N reals (forward), or the reverse ahead of the inverse cfft
+//-----------------------------------------------------------------------------
+static void rfft_split( const fft_plan * plan, float * x, unsigned int forward )
+{
+    float c1, c2, h1r, h1i, h2r, h2i, wr, wi, sign ;
+    float xr, xi ;
+    long N = plan->N ;
+    long i, i1, i2, i3, i4, N2p1 ;
 
-    theta = PI/N ;
-    wr = 1. ;
-    wi = 0. ;
     c1 = 0.5 ;
 
     if( forward )
     {
         c2 = -0.5 ;
-        cfft( x, N, forward ) ;
+        sign = 1. ;
         xr = x[0] ;
         xi = x[1] ;
     }
     else
     {
         c2 = 0.5 ;
-        theta = -theta ;
+        sign = -1. ;
         xr = x[1] ;
         xi = 0. ;
         x[1] = 0. ;
     }
-    
-    wpr = (float) (-2.*pow( sin( 0.5*theta ), 2. )) ;
-    wpi = (float) sin( theta ) ;
+
     N2p1 = (N<<1) + 1 ;
-    
+
     for( i = 0 ; i <= N>>1 ; i++ )
     {
+        wr = plan->rtw[2*i] ;
+        wi = sign * plan->rtw[2*i+1] ;
         i1 = i<<1 ;
         i2 = i1 + 1 ;
         i3 = N2p1 - i2 ;
@@ -179,56 +486,42 @@ void rfft( float * x, long N, unsigned int forward )
             x[i3] =  h1r - wr*h2r + wi*h2i ;
             x[i4] = -h1i + wr*h2i + wi*h2r ;
         }
-
-        wr = (temp = wr)*wpr - wi*wpi + wr ;
-        wi = wi*wpr + temp*wpi + wi ;
     }
 
     if( forward )
         x[1] = xr ;
-    else
-        cfft( x, N, forward ) ;
 }
 
 
 
 
 //-----------------------------------------------------------------------------
-// name: cfft()
-// desc: complex value fft
-//
-//   these routines from CARL software, spect.c
-//   check out the CARL CMusic distribution for more software
-//
-//   cfft replaces float array x containing NC complex values (2*NC float 
-//   values alternating real, imagininary, etc.) by its Fourier transform 
-//   if forward is true, or by its inverse Fourier transform ifforward is 
-//   false, using a recursive Fast Fourier transform method due to 
-//   Danielson and Lanczos.
-//
-//   NC MUST be a power of 2.
-//
+// name: cfft_stages_radix2()
+// desc: reference kernel; the original CARL butterfly loop over
+//       bit-reversed data, one radix-2 stage per pass; count frames of
+//       N complex back to back are transformed together
 //-----------------------------------------------------------------------------
-void cfft( float * x, long NC, unsigned int forward )
+static void cfft_stages_radix2( const fft_plan * plan, float * x, long count,
+                                unsigned int forward )
 {
-    float wr, wi, wpr, wpi, theta, scale ;
-    long mmax, ND, m, i, j, delta ;
-    ND = NC<<1 ;
-    bit_reverse( x, ND ) ;
-    
+    float wr, wi, sign ;
+    long mmax, ND, NT, m, i, j, delta, tstride ;
+    ND = plan->N<<1 ;
+    NT = ND * count ;
+    sign = forward ? 1. : -1. ;
+
     for( mmax = 2 ; mmax < ND ; mmax = delta )
     {
         delta = mmax<<1 ;
-        theta = TWOPI/( forward? mmax : -mmax ) ;
-        wpr = (float) (-2.*pow( sin( 0.5*theta ), 2. )) ;
-        wpi = (float) sin( theta ) ;
-        wr = 1. ;
-        wi = 0. ;
+        // twiddle k of this stage is exp(i*2pi*k/mmax) == tw[k*N/mmax]
+        tstride = (plan->N / mmax)<<1 ;
 
         for( m = 0 ; m < mmax ; m += 2 )
         {
-            register float rtemp, itemp ;
-            for( i = m ; i < ND ; i += delta )
+            float rtemp, itemp ;
+            wr = plan->tw[(m>>1) * tstride] ;
+            wi = sign * plan->tw[(m>>1) * tstride + 1] ;
+            for( i = m ; i < NT ; i += delta )
             {
                 j = i + mmax ;
                 rtemp = wr*x[j] - wi*x[j+1] ;
@@ -238,16 +531,292 @@ void cfft( float * x, long NC, unsigned int forward )
                 x[i] += rtemp ;
                 x[i+1] += itemp ;
             }
+        }
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: radix4_pass_scalar()
+// desc: stages with span h and 2h fused into one pass over the data.
+//       for each group of 4h points and k < h:
+//         stage h :  a,b = a +/- w1*b      c,d = c +/- w1*d
+//         stage 2h:  a,c = a +/- w2*c      b,d = b +/- (j*w2)*d
+//       with w1 = exp(j*pi*k/h), w2 = exp(j*pi*k/2h), j = sqrt(-1)
+//       (conjugated for the inverse)
+//-----------------------------------------------------------------------------
+static void radix4_pass_scalar( float * x, long NC, long h,
+                                const float * wr1, const float * wi1,
+                                const float * wr2, const float * wi2,
+                                float sign )
+{
+    long g, k;
+    float ar, ai, br, bi, cr, ci, dr, di, tr, ti, w1r, w1i, w2r, w2i;
+
+    for( g = 0; g < NC; g += h<<2 )
+    {
+        for( k = 0; k < h; k++ )
+        {
+            float * pa = x + ((g + k)<<1);
+            float * pb = pa + (h<<1);
+            float * pc = pb + (h<<1);
+            float * pd = pc + (h<<1);
+
+            w1r = wr1[2*k]; w1i = sign * wi1[2*k+1];
+            w2r = wr2[2*k]; w2i = sign * wi2[2*k+1];
+
+            tr = w1r*pb[0] - w1i*pb[1]; ti = w1r*pb[1] + w1i*pb[0];
+            ar = pa[0] + tr; ai = pa[1] + ti;
+            br = pa[0] - tr; bi = pa[1] - ti;
+            tr = w1r*pd[0] - w1i*pd[1]; ti = w1r*pd[1] + w1i*pd[0];
+            cr = pc[0] + tr; ci = pc[1] + ti;
+            dr = pc[0] - tr; di = pc[1] - ti;
+
+            tr = w2r*cr - w2i*ci; ti = w2r*ci + w2i*cr;
+            pa[0] = ar + tr; pa[1] = ai + ti;
+            pc[0] = ar - tr; pc[1] = ai - ti;
+            tr = w2r*dr - w2i*di; ti = w2r*di + w2i*dr;
+            // times +j (forward) or -j (inverse)
+            w1r = tr; tr = -sign * ti; ti = sign * w1r;
+            pb[0] = br + tr; pb[1] = bi + ti;
+            pd[0] = br - tr; pd[1] = bi - ti;
+        }
+    }
+}
+
+
+
+
+#ifdef __CHUCK_FFT_X86__
+//-----------------------------------------------------------------------------
+// name: radix4_pass_sse2()
+// desc: radix4_pass_scalar() two complex points at a time; h >= 2
+//-----------------------------------------------------------------------------
+__attribute__((target("sse2")))
+static void radix4_pass_sse2( float * x, long NC, long h,
+                              const float * wr1, const float * wi1,
+                              const float * wr2, const float * wi2,
+                              unsigned int forward )
+{
+    long g, k;
+    // conjugate twiddles for the inverse; +/-j rotation
+    const __m128 csign = _mm_set1_ps( forward ? 1.f : -1.f );
+    const __m128 jsign = forward ? _mm_setr_ps( -1.f, 1.f, -1.f, 1.f )
+                                 : _mm_setr_ps( 1.f, -1.f, 1.f, -1.f );
+
+#define CMUL_SSE( z, wr, wi ) _mm_add_ps( _mm_mul_ps( z, wr ), \
+    _mm_mul_ps( _mm_shuffle_ps( z, z, _MM_SHUFFLE(2,3,0,1) ), wi ) )
+
+    for( g = 0; g < NC; g += h<<2 )
+    {
+        for( k = 0; k < h; k += 2 )
+        {
+            float * pa = x + ((g + k)<<1);
+            float * pb = pa + (h<<1);
+            float * pc = pb + (h<<1);
+            float * pd = pc + (h<<1);
+            __m128 a = _mm_loadu_ps( pa ), b = _mm_loadu_ps( pb );
+            __m128 c = _mm_loadu_ps( pc ), d = _mm_loadu_ps( pd );
+            __m128 w1r = _mm_loadu_ps( wr1 + 2*k );
+            __m128 w1i = _mm_mul_ps( _mm_loadu_ps( wi1 + 2*k ), csign );
+            __m128 w2r = _mm_loadu_ps( wr2 + 2*k );
+            __m128 w2i = _mm_mul_ps( _mm_loadu_ps( wi2 + 2*k ), csign );
+            __m128 t, a1, b1, c1, d1;
+
+            t = CMUL_SSE( b, w1r, w1i );
+            a1 = _mm_add_ps( a, t ); b1 = _mm_sub_ps( a, t );
+            t = CMUL_SSE( d, w1r, w1i );
+            c1 = _mm_add_ps( c, t ); d1 = _mm_sub_ps( c, t );
+
+            t = CMUL_SSE( c1, w2r, w2i );
+            _mm_storeu_ps( pa, _mm_add_ps( a1, t ) );
+            _mm_storeu_ps( pc, _mm_sub_ps( a1, t ) );
+            t = CMUL_SSE( d1, w2r, w2i );
+            t = _mm_mul_ps( _mm_shuffle_ps( t, t, _MM_SHUFFLE(2,3,0,1) ), jsign );
+            _mm_storeu_ps( pb, _mm_add_ps( b1, t ) );
+            _mm_storeu_ps( pd, _mm_sub_ps( b1, t ) );
+        }
+    }
+
+#undef CMUL_SSE
+}
+
+
+
 
-            wr = (rtemp = wr)*wpr - wi*wpi + wr ;
-            wi = wi*wpr + rtemp*wpi + wi ;
+//-----------------------------------------------------------------------------
+// name: radix4_pass_avx()
+// desc: radix4_pass_scalar() four complex points at a time; h >= 4
+//-----------------------------------------------------------------------------
+__attribute__((target("avx")))
+static void radix4_pass_avx( float * x, long NC, long h,
+                             const float * wr1, const float * wi1,
+                             const float * wr2, const float * wi2,
+                             unsigned int forward )
+{
+    long g, k;
+    const __m256 csign = _mm256_set1_ps( forward ? 1.f : -1.f );
+    const __m256 jsign = forward
+        ? _mm256_setr_ps( -1.f, 1.f, -1.f, 1.f, -1.f, 1.f, -1.f, 1.f )
+        : _mm256_setr_ps( 1.f, -1.f, 1.f, -1.f, 1.f, -1.f, 1.f, -1.f );
+
+#define CMUL_AVX( z, wr, wi ) _mm256_add_ps( _mm256_mul_ps( z, wr ), \
+    _mm256_mul_ps( _mm256_permute_ps( z, 0xB1 ), wi ) )
+
+    for( g = 0; g < NC; g += h<<2 )
+    {
+        for( k = 0; k < h; k += 4 )
+        {
+            float * pa = x + ((g + k)<<1);
+            float * pb = pa + (h<<1);
+            float * pc = pb + (h<<1);
+            float * pd = pc + (h<<1);
+            __m256 a = _mm256_loadu_ps( pa ), b = _mm256_loadu_ps( pb );
+            __m256 c = _mm256_loadu_ps( pc ), d = _mm256_loadu_ps( pd );
+            __m256 w1r = _mm256_loadu_ps( wr1 + 2*k );
+            __m256 w1i = _mm256_mul_ps( _mm256_loadu_ps( wi1 + 2*k ), csign );
+            __m256 w2r = _mm256_loadu_ps( wr2 + 2*k );
+            __m256 w2i = _mm256_mul_ps( _mm256_loadu_ps( wi2 + 2*k ), csign );
+            __m256 t, a1, b1, c1, d1;
+
+            t = CMUL_AVX( b, w1r, w1i );
+            a1 = _mm256_add_ps( a, t ); b1 = _mm256_sub_ps( a, t );
+            t = CMUL_AVX( d, w1r, w1i );
+            c1 = _mm256_add_ps( c, t ); d1 = _mm256_sub_ps( c, t );
+
+            t = CMUL_AVX( c1, w2r, w2i );
+            _mm256_storeu_ps( pa, _mm256_add_ps( a1, t ) );
+            _mm256_storeu_ps( pc, _mm256_sub_ps( a1, t ) );
+            t = CMUL_AVX( d1, w2r, w2i );
+            t = _mm256_mul_ps( _mm256_permute_ps( t, 0xB1 ), jsign );
+            _mm256_storeu_ps( pb, _mm256_add_ps( b1, t ) );
+            _mm256_storeu_ps( pd, _mm256_sub_ps( b1, t ) );
+        }
+    }
+
+#undef CMUL_AVX
+}
+#endif
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: cfft_stages_radix4()
+// desc: all butterfly stages, two per pass; an odd stage count gets a
+//       plain radix-2 first stage (span 1, twiddle 1).  groups never
+//       straddle a frame, so count frames back to back are one long pass
+//-----------------------------------------------------------------------------
+static void cfft_stages_radix4( const fft_plan * plan, float * x, long count,
+                                unsigned int forward )
+{
+    long N = plan->N, NC = plan->N * count, h = 1, i;
+    long stages = 0;
+    float sign = forward ? 1.f : -1.f;
+
+    for( i = 1; i < N; i <<= 1 ) stages++;
+
+    if( stages & 1 )
+    {
+        float * p = x, * e = x + (NC<<1);
+        for( ; p < e; p += 4 )
+        {
+            float tr = p[2], ti = p[3];
+            p[2] = p[0] - tr; p[3] = p[1] - ti;
+            p[0] += tr; p[1] += ti;
         }
+        h = 2;
     }
 
+    for( ; h < N; h <<= 2 )
+    {
+        const float * wr1 = plan->swr + 2*(h-1);
+        const float * wi1 = plan->swi + 2*(h-1);
+        const float * wr2 = plan->swr + 2*(2*h-1);
+        const float * wi2 = plan->swi + 2*(2*h-1);
+
+#ifdef __CHUCK_FFT_X86__
+        if( plan->kernel == FFT_KERNEL_AVX && h >= 4 )
+        {
+            radix4_pass_avx( x, NC, h, wr1, wi1, wr2, wi2, forward );
+            continue;
+        }
+        if( plan->kernel >= FFT_KERNEL_SSE2 && h >= 2 )
+        {
+            radix4_pass_sse2( x, NC, h, wr1, wi1, wr2, wi2, forward );
+            continue;
+        }
+#endif
+        radix4_pass_scalar( x, NC, h, wr1, wi1, wr2, wi2, sign );
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_plan_cfft()
+// desc: complex value fft
+//
+//   these routines from CARL software, spect.c
+//   check out the CARL CMusic distribution for more software
+//
+//   cfft replaces float array x containing NC complex values (2*NC float 
+//   values alternating real, imagininary, etc.) by its Fourier transform 
+//   if forward is true, or by its inverse Fourier transform ifforward is 
+//   false, using a recursive Fast Fourier transform method due to 
+//   Danielson and Lanczos.
+//
+//   NC is taken from the plan; twiddles are looked up, not recurred.
+//   the butterflies run in the kernel chosen when the plan was made.
+//
+//-----------------------------------------------------------------------------
+void fft_plan_cfft( const fft_plan * plan, float * x, unsigned int forward )
+{
+    fft_plan_cfft_batch( plan, x, 1, forward ) ;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: fft_plan_cfft_batch()
+// desc: cfft of count frames stored back to back (count x 2N floats)
+//-----------------------------------------------------------------------------
+void fft_plan_cfft_batch( const fft_plan * plan, float * x, long count,
+                          unsigned int forward )
+{
+    float scale ;
+    long ND, f, i, j ;
+    ND = plan->N<<1 ;
+
+    // bit reverse from the precomputed exchange list
+    for( f = 0 ; f < count ; f++ )
+    {
+        float * xf = x + f*ND ;
+        const long * sw = plan->swaps ;
+        const long * se = sw + 2 * plan->nswaps ;
+        for( ; sw < se ; sw += 2 )
+        {
+            float rtemp, itemp ;
+            i = sw[0] ; j = sw[1] ;
+            rtemp = xf[j] ; itemp = xf[j+1] ; /* complex exchange */
+            xf[j] = xf[i] ; xf[j+1] = xf[i+1] ;
+            xf[i] = rtemp ; xf[i+1] = itemp ;
+        }
+    }
+
+    if( plan->kernel == FFT_KERNEL_SCALAR )
+        cfft_stages_radix2( plan, x, count, forward ) ;
+    else
+        cfft_stages_radix4( plan, x, count, forward ) ;
+
     // scale output
     scale = (float)(forward ? 1./ND : 2.) ;
     {
-        register float *xi=x, *xe=x+ND ;
+        float *xi=x, *xe=x+ND*count ;
         while( xi < xe )
             *xi++ *= scale ;
     }
@@ -256,25 +825,427 @@ void cfft( float * x, long NC, unsigned int forward )
 
 
 
+// per-thread storage for the cached plans
+#if defined( __cplusplus )
+#define FFT_THREAD_LOCAL thread_local
+#elif defined( _MSC_VER )
+#define FFT_THREAD_LOCAL __declspec( thread )
+#else
+#define FFT_THREAD_LOCAL _Thread_local
+#endif
+
+// plans for the unplanned entry points, one per power of two, per thread
+static FFT_THREAD_LOCAL fft_plan * cached_plans[sizeof(long) * 8];
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: cached_plan()
+// desc: this thread's plan for N, built on first use and kept, so no
+//       other caller can free it and alternating sizes rebuild nothing;
+//       NULL if N is not a power of 2 or there is no memory for it
+//-----------------------------------------------------------------------------
+static fft_plan * cached_plan( long N )
+{
+    int lg = 0;
+
+    if( N < 1 || (N & (N-1)) ) return NULL;
+    while( (1L << lg) < N ) lg++;
+    if( !cached_plans[lg] )
+        cached_plans[lg] = fft_plan_create( N );
+
+    return cached_plans[lg];
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: rfft()
+// desc: real value fft; see fft_plan_rfft()
+//
+//   N MUST be a power of 2.
+//
+//-----------------------------------------------------------------------------
+void rfft( float * x, long N, unsigned int forward )
+{
+    fft_plan * plan = cached_plan( N );
+
+    if( plan )
+        fft_plan_rfft( plan, x, forward );
+    // not cached: a plan for this call only
+    else if( (plan = fft_plan_create( N )) != NULL )
+    {
+        fft_plan_rfft( plan, x, forward );
+        fft_plan_destroy( plan );
+    }
+}
+
+
+
+
 //-----------------------------------------------------------------------------
-// name: bit_reverse()
-// desc: bitreverse places float array x containing N/2 complex values
-//       into bit-reversed order
+// name: cfft()
+// desc: complex value fft; see fft_plan_cfft()
+//
+//   NC MUST be a power of 2.
+//
 //-----------------------------------------------------------------------------
-void bit_reverse( float * x, long N )
+void cfft( float * x, long NC, unsigned int forward )
 {
-    float rtemp, itemp ;
-    long i, j, m ;
-    for( i = j = 0 ; i < N ; i += 2, j += m )
+    fft_plan * plan = cached_plan( NC );
+
+    if( plan )
+        fft_plan_cfft( plan, x, forward );
+    // not cached: a plan for this call only
+    else if( (plan = fft_plan_create( NC )) != NULL )
     {
-        if( j > i )
+        fft_plan_cfft( plan, x, forward );
+        fft_plan_destroy( plan );
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: struct window_entry
+// desc: one window in the cache
+//-----------------------------------------------------------------------------
+struct window_entry
+{
+    int type;
+    unsigned long length;
+    float beta;
+    float * window;
+    struct window_entry * next;
+};
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: window_name()
+// desc: printable window name
+//-----------------------------------------------------------------------------
+const char * window_name( int type )
+{
+    switch( type )
+    {
+        case WINDOW_HANN: return "hann";
+        case WINDOW_HAMMING: return "hamming";
+        case WINDOW_BLACKMAN: return "blackman";
+        case WINDOW_BLACKMAN_HARRIS: return "blackman-harris";
+        case WINDOW_KAISER: return "kaiser";
+        default: return "unknown";
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: window_cached()
+// desc: look the window up, building it the first time; entries are never
+//       freed, so returned pointers stay valid (only a handful of sizes are
+//       ever asked for); NULL for an unknown type or no memory
+//-----------------------------------------------------------------------------
+const float * window_cached( int type, unsigned long length, float beta )
+{
+    static struct window_entry * cache = NULL;
+    struct window_entry * e;
+
+    if( type < WINDOW_HANN || type > WINDOW_KAISER ) return NULL;
+    if( type != WINDOW_KAISER ) beta = 0;
+    for( e = cache; e; e = e->next )
+        if( e->type == type && e->length == length && e->beta == beta )
+            return e->window;
+
+    if( length == 0 ) return NULL;
+    e = (struct window_entry *)malloc( sizeof(struct window_entry) );
+    if( !e ) return NULL;
+    e->window = (float *)malloc( sizeof(float) * length );
+    if( !e->window )
+    {
+        free( e );
+        return NULL;
+    }
+
+    switch( type )
+    {
+        case WINDOW_HANN: hanning( e->window, length ); break;
+        case WINDOW_HAMMING: hamming( e->window, length ); break;
+        case WINDOW_BLACKMAN: blackman( e->window, length ); break;
+        case WINDOW_BLACKMAN_HARRIS: blackman_harris( e->window, length ); break;
+        case WINDOW_KAISER: kaiser( e->window, length, beta ); break;
+    }
+    e->type = type;
+    e->length = length;
+    e->beta = beta;
+    e->next = cache;
+    cache = e;
+
+    return e->window;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: window_mul_scalar()
+// desc: dest[i] = src[i] * window[i]
+//-----------------------------------------------------------------------------
+static void window_mul_scalar( float * dest, const float * src,
+                               const float * window, unsigned long n )
+{
+    unsigned long i;
+
+    for( i = 0; i < n; i++ )
+        dest[i] = src[i] * window[i];
+}
+
+
+
+
+#ifdef __CHUCK_FFT_X86__
+//-----------------------------------------------------------------------------
+// name: window_mul_sse2()
+// desc: window_mul_scalar(), four at a time
+//-----------------------------------------------------------------------------
+__attribute__((target("sse2")))
+static void window_mul_sse2( float * dest, const float * src,
+                             const float * window, unsigned long n )
+{
+    unsigned long i;
+
+    for( i = 0; i + 4 <= n; i += 4 )
+        _mm_storeu_ps( dest + i, _mm_mul_ps( _mm_loadu_ps( src + i ),
+                                             _mm_loadu_ps( window + i ) ) );
+    window_mul_scalar( dest + i, src + i, window + i, n - i );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: window_mul_avx()
+// desc: window_mul_scalar(), eight at a time
+//-----------------------------------------------------------------------------
+__attribute__((target("avx")))
+static void window_mul_avx( float * dest, const float * src,
+                            const float * window, unsigned long n )
+{
+    unsigned long i;
+
+    for( i = 0; i + 8 <= n; i += 8 )
+        _mm256_storeu_ps( dest + i, _mm256_mul_ps( _mm256_loadu_ps( src + i ),
+                                                   _mm256_loadu_ps( window + i ) ) );
+    window_mul_scalar( dest + i, src + i, window + i, n - i );
+}
+#endif
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: window_copy()
+// desc: windowed copy out of a circular buffer: the run up to the end of
+//       the ring, then the run from its start
+//-----------------------------------------------------------------------------
+void window_copy( float * dest, const float * ring, unsigned long ringSize,
+                  unsigned long start, const float * window,
+                  unsigned long length )
+{
+    static void (*mul)( float *, const float *, const float *, unsigned long ) = NULL;
+    unsigned long first;
+
+    if( !mul )
+    {
+        mul = window_mul_scalar;
+#ifdef __CHUCK_FFT_X86__
+        if( fft_kernel_supported( FFT_KERNEL_AVX ) ) mul = window_mul_avx;
+        else if( fft_kernel_supported( FFT_KERNEL_SSE2 ) ) mul = window_mul_sse2;
+#endif
+    }
+
+    start %= ringSize;
+    first = ringSize - start;
+    if( first > length ) first = length;
+    mul( dest, ring + start, window, first );
+    mul( dest + first, ring, window + first, length - first );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: spectrum_compress_scalar()
+// desc: reference spectrum_compress(); also does the tail of the simd path
+//-----------------------------------------------------------------------------
+static void spectrum_compress_scalar( const complex * x, float * out, long n,
+                                      int curve, float gain, float floor )
+{
+    long i;
+    float power, floor2 = floor * floor;
+    // half of log10( power / floor^2 ) is log10( |x| / floor )
+    float lscale = gain * 0.5f;
+
+    if( floor2 < FLT_MIN ) floor2 = FLT_MIN;
+    for( i = 0; i < n; i++ )
+    {
+        power = x[i].re * x[i].re + x[i].im * x[i].im;
+        switch( curve )
         {
-            rtemp = x[j] ; itemp = x[j+1] ; /* complex exchange */
-            x[j] = x[i] ; x[j+1] = x[i+1] ;
-            x[i] = rtemp ; x[i+1] = itemp ;
+            case SPECTRUM_CBRT:
+                out[i] = gain * cbrtf( sqrtf( power ) );
+                break;
+            case SPECTRUM_LOG10:
+                out[i] = lscale * log10f( ( power > floor2 ? power : floor2 ) / floor2 );
+                break;
+            default:
+                out[i] = gain * sqrtf( sqrtf( power ) );
+                break;
         }
+    }
+}
+
+
+
+
+#ifdef __CHUCK_FFT_X86__
+//-----------------------------------------------------------------------------
+// name: log_sse2()
+// desc: natural log of 4 positive normal floats (cephes logf polynomial,
+//       about 1 ulp on [FLT_MIN, FLT_MAX])
+//-----------------------------------------------------------------------------
+__attribute__((target("sse2")))
+static inline __m128 log_sse2( __m128 v )
+{
+    const __m128 one = _mm_set1_ps( 1.f );
+    __m128i bits = _mm_castps_si128( v );
+    // v = m * 2^e, m in [0.5, 1)
+    __m128 e = _mm_cvtepi32_ps( _mm_sub_epi32( _mm_srli_epi32( bits, 23 ),
+                                               _mm_set1_epi32( 126 ) ) );
+    __m128 m = _mm_castsi128_ps( _mm_or_si128(
+        _mm_and_si128( bits, _mm_set1_epi32( 0x007FFFFF ) ),
+        _mm_set1_epi32( 0x3F000000 ) ) );
+    // m < sqrt(1/2): use 2m - 1 and e - 1, else m - 1
+    __m128 small = _mm_cmplt_ps( m, _mm_set1_ps( 0.707106781186547524f ) );
+    __m128 x = _mm_sub_ps( _mm_add_ps( m, _mm_and_ps( m, small ) ), one );
+    e = _mm_sub_ps( e, _mm_and_ps( one, small ) );
+
+    __m128 z = _mm_mul_ps( x, x );
+    __m128 y = _mm_set1_ps( 7.0376836292E-2f );
+    y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps( -1.1514610310E-1f ) );
+    y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps( 1.1676998740E-1f ) );
+    y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps( -1.2420140846E-1f ) );
+    y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps( 1.4249322787E-1f ) );
+    y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps( -1.6668057665E-1f ) );
+    y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps( 2.0000714765E-1f ) );
+    y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps( -2.4999993993E-1f ) );
+    y = _mm_add_ps( _mm_mul_ps( y, x ), _mm_set1_ps( 3.3333331174E-1f ) );
+    y = _mm_mul_ps( _mm_mul_ps( y, x ), z );
+    y = _mm_add_ps( y, _mm_mul_ps( e, _mm_set1_ps( -2.12194440e-4f ) ) );
+    y = _mm_sub_ps( y, _mm_mul_ps( z, _mm_set1_ps( 0.5f ) ) );
+    x = _mm_add_ps( x, y );
+    return _mm_add_ps( x, _mm_mul_ps( e, _mm_set1_ps( 0.693359375f ) ) );
+}
+
+
+
 
-        for( m = N>>1 ; m >= 2 && j >= m ; m >>= 1 )
-            j -= m ;
+//-----------------------------------------------------------------------------
+// name: cbrt_sse2()
+// desc: cube root of 4 non-negative floats: exponent-divide estimate,
+//       then three newton steps (to float precision); 0 stays 0
+//-----------------------------------------------------------------------------
+__attribute__((target("sse2")))
+static inline __m128 cbrt_sse2( __m128 m )
+{
+    const __m128 third = _mm_set1_ps( 1.f / 3.f );
+    // bits/3 + bias lands within a few percent of the root
+    __m128i bits = _mm_castps_si128( m );
+    __m128i est = _mm_cvtps_epi32( _mm_mul_ps( _mm_cvtepi32_ps( bits ), third ) );
+    __m128 y = _mm_castsi128_ps( _mm_add_epi32( est, _mm_set1_epi32( 0x2a514067 ) ) );
+    int k;
+
+    // y = (2y + m / y^2) / 3
+    for( k = 0; k < 3; k++ )
+        y = _mm_mul_ps( _mm_add_ps( _mm_add_ps( y, y ),
+                                    _mm_div_ps( m, _mm_mul_ps( y, y ) ) ), third );
+
+    return _mm_and_ps( y, _mm_cmpgt_ps( m, _mm_setzero_ps() ) );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: spectrum_compress_sse2()
+// desc: spectrum_compress() four bins at a time
+//-----------------------------------------------------------------------------
+__attribute__((target("sse2")))
+static long spectrum_compress_sse2( const complex * x, float * out, long n,
+                                    int curve, float gain, float floor )
+{
+    const float * p = (const float *)x;
+    const __m128 vgain = _mm_set1_ps( gain );
+    float floor2 = floor * floor;
+    __m128 vfloor2, vlfloor2, vlscale;
+    long i;
+
+    if( floor2 < FLT_MIN ) floor2 = FLT_MIN;
+    vfloor2 = _mm_set1_ps( floor2 );
+    vlfloor2 = _mm_set1_ps( logf( floor2 ) );
+    // gain * 0.5 * log10( power / floor^2 ) = lscale * ( ln power - ln floor^2 )
+    vlscale = _mm_set1_ps( gain * 0.5f / 2.302585092994046f );
+
+    for( i = 0; i + 4 <= n; i += 4 )
+    {
+        __m128 a = _mm_loadu_ps( p + 2*i );
+        __m128 b = _mm_loadu_ps( p + 2*i + 4 );
+        __m128 re, im, power, v;
+        // deinterleave re and im
+        re = _mm_shuffle_ps( a, b, _MM_SHUFFLE(2,0,2,0) );
+        im = _mm_shuffle_ps( a, b, _MM_SHUFFLE(3,1,3,1) );
+        power = _mm_add_ps( _mm_mul_ps( re, re ), _mm_mul_ps( im, im ) );
+
+        switch( curve )
+        {
+            case SPECTRUM_CBRT:
+                v = _mm_mul_ps( vgain, cbrt_sse2( _mm_sqrt_ps( power ) ) );
+                break;
+            case SPECTRUM_LOG10:
+                v = _mm_sub_ps( log_sse2( _mm_max_ps( power, vfloor2 ) ), vlfloor2 );
+                v = _mm_mul_ps( vlscale, v );
+                break;
+            default:
+                v = _mm_mul_ps( vgain, _mm_sqrt_ps( _mm_sqrt_ps( power ) ) );
+                break;
+        }
+        _mm_storeu_ps( out + i, v );
     }
+
+    return i;
+}
+#endif
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: spectrum_compress()
+// desc: |x| then the curve, per bin; simd where the cpu has it
+//-----------------------------------------------------------------------------
+void spectrum_compress( const complex * x, float * out, long n, int curve,
+                        float gain, float floor )
+{
+    long done = 0;
+
+#ifdef __CHUCK_FFT_X86__
+    if( fft_kernel_supported( FFT_KERNEL_SSE2 ) )
+        done = spectrum_compress_sse2( x, out, n, curve, gain, floor );
+#endif
+    spectrum_compress_scalar( x + done, out + done, n - done, curve, gain, floor );
 }
@@ -20,6 +20,25 @@ typedef struct { float re ; float im ; } complex;
 #define FFT_FORWARD 1
 #define FFT_INVERSE 0
 
+// butterfly kernels for planned ffts
+#define FFT_KERNEL_AUTO   0  // best supported by this cpu
+#define FFT_KERNEL_SCALAR 1  // reference radix-2 (CARL)
+#define FFT_KERNEL_RADIX4 2  // portable radix-2^2, two stages per pass
+#define FFT_KERNEL_SSE2   3  // radix-2^2, SSE2
+#define FFT_KERNEL_AVX    4  // radix-2^2, AVX
+
+// analysis windows for window_cached()
+#define WINDOW_HANN            0
+#define WINDOW_HAMMING         1
+#define WINDOW_BLACKMAN        2
+#define WINDOW_BLACKMAN_HARRIS 3  // 4-term, -92 dB sidelobes
+#define WINDOW_KAISER          4  // shape set by beta
+
+// magnitude compression curves for spectrum_compress()
+#define SPECTRUM_SQRT  0  // gain * |x|^(1/2)
+#define SPECTRUM_CBRT  1  // gain * |x|^(1/3)
+#define SPECTRUM_LOG10 2  // gain * log10( max(|x|, floor) / floor )
+
 // c linkage
 #if ( defined( __cplusplus ) || defined( _cplusplus ) )
   extern "C" {
@@ -29,13 +48,61 @@ typedef struct { float re ; float im ; } complex;
 void hanning( float * window, unsigned long length );
 void hamming( float * window, unsigned long length );
 void blackman( float * window, unsigned long length );
+void blackman_harris( float * window, unsigned long length );
+void kaiser( float * window, unsigned long length, float beta );
 // apply the window
 void apply_window( float * data, float * window, unsigned long length );
+// shared window of a WINDOW_* type and length (beta: kaiser only), built
+// on first use and kept for the life of the process; not thread safe.
+// NULL for an unknown type
+const float * window_cached( int type, unsigned long length, float beta );
+// printable window name
+const char * window_name( int type );
+// fused copy + window: dest[i] = ring[(start + i) % ringSize] * window[i]
+// for i < length (length <= ringSize), one vectorized pass
+void window_copy( float * dest, const float * ring, unsigned long ringSize,
+                  unsigned long start, const float * window,
+                  unsigned long length );
 
 // real fft, N must be power of 2
 void rfft( float * x, long N, unsigned int forward );
 // complex fft, NC must be power of 2
 void cfft( float * x, long NC, unsigned int forward );
+// rfft() and cfft() share hidden state: a cache of plans, one per size,
+// kept per thread.  so several threads may call them at once, but they
+// are not async-signal safe, the first call for each size allocates (keep
+// them off the audio thread) and the cached plans are never freed.  with
+// no memory for a plan they leave x untouched.  code that needs more
+// control should hold its own fft_plan.
+
+// planned fft: twiddles and bit-reversal computed once per size
+typedef struct fft_plan fft_plan;
+// create a plan for rfft of 2*N reals (== cfft of N complex), N power of 2
+fft_plan * fft_plan_create( long N );
+// same, with a specific FFT_KERNEL_*; unsupported kernels fall back
+fft_plan * fft_plan_create_kernel( long N, int kernel );
+// destroy a plan
+void fft_plan_destroy( fft_plan * plan );
+// size (N) the plan was created for
+long fft_plan_size( const fft_plan * plan );
+// FFT_KERNEL_* actually used by the plan
+int fft_plan_kernel( const fft_plan * plan );
+// printable kernel name
+const char * fft_kernel_name( int kernel );
+// same packing and scaling as rfft( x, N, forward )
+void fft_plan_rfft( const fft_plan * plan, float * x, unsigned int forward );
+// same packing and scaling as cfft( x, N, forward )
+void fft_plan_cfft( const fft_plan * plan, float * x, unsigned int forward );
+// batched: count frames of 2N floats back to back, transformed in place
+void fft_plan_rfft_batch( const fft_plan * plan, float * x, long count,
+                          unsigned int forward );
+void fft_plan_cfft_batch( const fft_plan * plan, float * x, long count,
+                          unsigned int forward );
+
+// fused magnitude + compression of n bins, one vectorized pass:
+// out[i] = curve( |x[i]| ); floor (> 0) is only used by SPECTRUM_LOG10
+void spectrum_compress( const complex * x, float * out, long n, int curve,
+                        float gain, float floor );
 
 // c linkage
 #if ( defined( __cplusplus ) || defined( _cplusplus ) )
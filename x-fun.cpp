@@ -41,6 +41,7 @@
 #include <math.h>
 #include <iostream>
 #include <algorithm>
+#include <atomic>
 
 using namespace std;
 
@@ -67,7 +68,7 @@ long XFun::rand2i( long low, long high )
 
 //-----------------------------------------------------------------------------
 // name: rand2f()
-// desc: generates random double in [low, high]
+// desc: generates random double in [low, high)
 //-----------------------------------------------------------------------------
 double XFun::rand2f( double low, double high )
 {
@@ -79,7 +80,7 @@ double XFun::rand2f( double low, double high )
     // diff
     double diff = high - low;
     // go
-    return low + diff * random() / (double)0x7fffffff;
+    return low + diff * XRandom::local().nextd();
 }
 
 
@@ -93,6 +94,95 @@ void XFun::srand()
 {
     // seed
     srandom( (unsigned int)time( NULL ) );
+    XRandom::seedAll( (uint64_t)time( NULL ) );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: srand()
+// desc: seeds random reproducibly
+//-----------------------------------------------------------------------------
+void XFun::srand( uint64_t seed )
+{
+    // seed
+    srandom( (unsigned int)seed );
+    XRandom::seedAll( seed );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: XRandom::seed()
+// desc: expand a 64-bit seed into generator state with splitmix64
+//-----------------------------------------------------------------------------
+void XRandom::seed( uint64_t s )
+{
+    for( int i = 0; i < 4; i += 2 )
+    {
+        uint64_t z = mix64( s += 0x9e3779b97f4a7c15ULL );
+        m_s[i] = (uint32_t)z;
+        m_s[i+1] = (uint32_t)(z >> 32);
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: XRandom::fill()
+// desc: n floats in [low, high)
+//-----------------------------------------------------------------------------
+void XRandom::fill( float * out, size_t n, float low, float high )
+{
+    float diff = high - low;
+    for( size_t i = 0; i < n; i++ )
+        out[i] = low + diff * nextf();
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: XRandom::fill()
+// desc: n raw 32-bit values
+//-----------------------------------------------------------------------------
+void XRandom::fill( uint32_t * out, size_t n )
+{
+    for( size_t i = 0; i < n; i++ )
+        out[i] = next();
+}
+
+
+
+
+// global seed and the number of threads that have asked for a generator
+static std::atomic<uint64_t> g_xrandomSeed( 0x853c49e6748fea9bULL );
+static std::atomic<uint64_t> g_xrandomThreads( 0 );
+//-----------------------------------------------------------------------------
+// name: XRandom::local()
+// desc: per-thread generator, created on first use
+//-----------------------------------------------------------------------------
+XRandom & XRandom::local()
+{
+    static thread_local XRandom rng( streamSeed( g_xrandomSeed.load(),
+                                                 g_xrandomThreads++ ) );
+    return rng;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: XRandom::seedAll()
+// desc: new global seed; the calling thread restarts as stream 0
+//-----------------------------------------------------------------------------
+void XRandom::seedAll( uint64_t s )
+{
+    g_xrandomSeed.store( s );
+    local().seed( streamSeed( s, 0 ) );
 }
 
 
@@ -44,6 +44,11 @@
 #include <vector>
 #include <time.h>
 #include <stdio.h>
+#include <stdint.h>
+
+// XRandom::local() hands out streams 0, 1, 2, ... per thread; callers
+// seeding their own generators take stream indices from here up
+#define XRANDOM_USER_STREAMS (1ULL << 32)
 
 
 
@@ -57,10 +62,12 @@ class XFun
 public:
     // random integer in [low, high]
     static long rand2i( long low, long high );
-    // random double in [low, high]
+    // random double in [low, high) (per-thread XRandom, no locks)
     static double rand2f( double low, double high );
-    // seed random
+    // seed random from the clock
     static void srand();
+    // seed random reproducibly
+    static void srand( uint64_t seed );
 
     // frequency to midi
     static double freq2midi( double freq );
@@ -90,4 +97,70 @@ public:
 
 
 
+//-----------------------------------------------------------------------------
+// name: class XRandom
+// desc: small seedable generator (xoshiro128**); no locks, no shared
+//       state -- give each thread or work chunk its own
+//-----------------------------------------------------------------------------
+class XRandom
+{
+public:
+    XRandom( uint64_t s = 0x853c49e6748fea9bULL ) { seed( s ); }
+
+public:
+    // reset the stream; the same seed always gives the same sequence
+    void seed( uint64_t s );
+    // next 32 random bits
+    inline uint32_t next()
+    {
+        uint32_t result = rotl( m_s[1] * 5, 7 ) * 9;
+        uint32_t t = m_s[1] << 9;
+        m_s[2] ^= m_s[0]; m_s[3] ^= m_s[1];
+        m_s[1] ^= m_s[2]; m_s[0] ^= m_s[3];
+        m_s[2] ^= t; m_s[3] = rotl( m_s[3], 11 );
+        return result;
+    }
+    // random float in [0, 1)
+    inline float nextf()
+    { return (next() >> 8) * (1.0f / 16777216.0f); }
+    // random double in [0, 1), 53 bits
+    inline double nextd()
+    { uint64_t hi = next() >> 5, lo = next() >> 6;
+      return (hi * 67108864.0 + lo) * (1.0 / 9007199254740992.0); }
+    // random float in [low, high)
+    inline float rand2f( float low, float high )
+    { return low + (high - low) * nextf(); }
+    // fill n floats in [low, high)
+    void fill( float * out, size_t n, float low, float high );
+    // fill n raw 32-bit values
+    void fill( uint32_t * out, size_t n );
+
+public:
+    // the calling thread's generator; thread k gets stream k of the
+    // global seed, so a fixed seed and thread layout reproduce exactly
+    static XRandom & local();
+    // set the global seed and reseed the calling thread's generator
+    static void seedAll( uint64_t s );
+    // seed for stream k of seed s.  both are hashed, so streams are
+    // unrelated states (seed() itself walks s in golden-ratio steps, so
+    // seeds that many steps apart would share state words)
+    static uint64_t streamSeed( uint64_t s, uint64_t k )
+    { return mix64( s ) ^ mix64( k + 0x9e3779b97f4a7c15ULL ); }
+    // splitmix64's finalizer: a bijective 64-bit mix
+    static inline uint64_t mix64( uint64_t z )
+    { z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      return z ^ (z >> 31); }
+
+private:
+    static inline uint32_t rotl( uint32_t x, int k )
+    { return (x << k) | (x >> (32 - k)); }
+
+private:
+    uint32_t m_s[4];
+};
+
+
+
+
 #endif
@@ -0,0 +1,307 @@
+//-----------------------------------------------------------------------------
+// name: x-offscreen.cpp
+// desc: windowless software GL context and frame image writers
+//-----------------------------------------------------------------------------
+#include "x-offscreen.h"
+#include "x-def.h"
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+
+#ifdef __MACOSX_CORE__
+#include <OpenGL/OpenGL.h>
+#include <OpenGL/gl.h>
+#include <OpenGL/glext.h>
+#else
+#define GL_GLEXT_PROTOTYPES
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+#endif
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: XOffscreen()
+// desc: constructor
+//-----------------------------------------------------------------------------
+XOffscreen::XOffscreen()
+    : m_width( 0 ), m_height( 0 ), m_display( NULL ), m_context( NULL ),
+      m_fbo( 0 ), m_color( 0 ), m_depth( 0 ), m_pixels( NULL )
+{ }
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: ~XOffscreen()
+// desc: destructor
+//-----------------------------------------------------------------------------
+XOffscreen::~XOffscreen()
+{
+    cleanup();
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: init()
+// desc: context, then a framebuffer object to draw into
+//-----------------------------------------------------------------------------
+bool XOffscreen::init( long width, long height )
+{
+    cleanup();
+    if( width <= 0 || height <= 0 )
+        return false;
+
+#ifdef __MACOSX_CORE__
+    // the generic (software) renderer works without a window server session
+    CGLPixelFormatAttribute attrs[] = {
+        kCGLPFARendererID, (CGLPixelFormatAttribute)kCGLRendererGenericFloatID,
+        kCGLPFAColorSize, (CGLPixelFormatAttribute)24,
+        kCGLPFAAlphaSize, (CGLPixelFormatAttribute)8,
+        kCGLPFADepthSize, (CGLPixelFormatAttribute)24,
+        (CGLPixelFormatAttribute)0
+    };
+    CGLPixelFormatObj pix = NULL;
+    GLint numPix = 0;
+    if( CGLChoosePixelFormat( attrs, &pix, &numPix ) != kCGLNoError || !pix )
+        return false;
+    CGLContextObj ctx = NULL;
+    CGLError err = CGLCreateContext( pix, NULL, &ctx );
+    CGLDestroyPixelFormat( pix );
+    if( err != kCGLNoError || !ctx )
+        return false;
+    m_context = ctx;
+    CGLSetCurrentContext( ctx );
+#else
+    // prefer mesa's surfaceless platform: no X server, no GPU needed
+    EGLDisplay dpy = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress( "eglGetPlatformDisplayEXT" );
+    if( getPlatformDisplay )
+        dpy = getPlatformDisplay( EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL );
+    if( dpy == EGL_NO_DISPLAY )
+        dpy = eglGetDisplay( EGL_DEFAULT_DISPLAY );
+    if( dpy == EGL_NO_DISPLAY || !eglInitialize( dpy, NULL, NULL ) )
+        return false;
+    m_display = dpy;
+
+    // desktop GL (compatibility profile) for the fixed-function pipeline
+    EGLint attrs[] = {
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_NONE
+    };
+    EGLConfig config = EGL_NO_CONFIG_KHR;
+    EGLint numConfigs = 0;
+    if( !eglBindAPI( EGL_OPENGL_API ) ||
+        !eglChooseConfig( dpy, attrs, &config, 1, &numConfigs ) )
+    {
+        cleanup();
+        return false;
+    }
+    // the surfaceless platform has no window configs; without one, rely on
+    // EGL_KHR_no_config_context (the framebuffer object defines the format)
+    if( numConfigs < 1 ) config = EGL_NO_CONFIG_KHR;
+    EGLContext ctx = eglCreateContext( dpy, config, EGL_NO_CONTEXT, NULL );
+    if( ctx == EGL_NO_CONTEXT )
+    {
+        cleanup();
+        return false;
+    }
+    m_context = ctx;
+    // no surface at all; everything goes to the framebuffer object
+    if( !eglMakeCurrent( dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, ctx ) )
+    {
+        cleanup();
+        return false;
+    }
+#endif
+
+    // color and depth renderbuffers
+    glGenFramebuffersEXT( 1, &m_fbo );
+    glGenRenderbuffersEXT( 1, &m_color );
+    glGenRenderbuffersEXT( 1, &m_depth );
+    glBindFramebufferEXT( GL_FRAMEBUFFER_EXT, m_fbo );
+    glBindRenderbufferEXT( GL_RENDERBUFFER_EXT, m_color );
+    glRenderbufferStorageEXT( GL_RENDERBUFFER_EXT, GL_RGBA8, width, height );
+    glFramebufferRenderbufferEXT( GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT,
+                                  GL_RENDERBUFFER_EXT, m_color );
+    glBindRenderbufferEXT( GL_RENDERBUFFER_EXT, m_depth );
+    glRenderbufferStorageEXT( GL_RENDERBUFFER_EXT, GL_DEPTH_COMPONENT24, width, height );
+    glFramebufferRenderbufferEXT( GL_FRAMEBUFFER_EXT, GL_DEPTH_ATTACHMENT_EXT,
+                                  GL_RENDERBUFFER_EXT, m_depth );
+    glBindRenderbufferEXT( GL_RENDERBUFFER_EXT, 0 );
+    if( glCheckFramebufferStatusEXT( GL_FRAMEBUFFER_EXT ) != GL_FRAMEBUFFER_COMPLETE_EXT )
+    {
+        cleanup();
+        return false;
+    }
+
+    glDrawBuffer( GL_COLOR_ATTACHMENT0_EXT );
+    glReadBuffer( GL_COLOR_ATTACHMENT0_EXT );
+    glViewport( 0, 0, width, height );
+
+    m_width = width;
+    m_height = height;
+    m_pixels = new unsigned char[width * height * 4];
+
+    return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: cleanup()
+// desc: release framebuffer and context
+//-----------------------------------------------------------------------------
+void XOffscreen::cleanup()
+{
+    if( m_context )
+    {
+        if( m_fbo ) glDeleteFramebuffersEXT( 1, &m_fbo );
+        if( m_color ) glDeleteRenderbuffersEXT( 1, &m_color );
+        if( m_depth ) glDeleteRenderbuffersEXT( 1, &m_depth );
+#ifdef __MACOSX_CORE__
+        CGLSetCurrentContext( NULL );
+        CGLDestroyContext( (CGLContextObj)m_context );
+#else
+        eglMakeCurrent( m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
+        eglDestroyContext( m_display, m_context );
+#endif
+    }
+#ifndef __MACOSX_CORE__
+    if( m_display ) eglTerminate( m_display );
+#endif
+
+    SAFE_DELETE_ARRAY( m_pixels );
+    m_display = m_context = NULL;
+    m_fbo = m_color = m_depth = 0;
+    m_width = m_height = 0;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: read()
+// desc: finish the frame and copy it out, flipped to top row first
+//-----------------------------------------------------------------------------
+void XOffscreen::read( unsigned char * dest )
+{
+    long stride = m_width * 4;
+
+    glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+    glReadPixels( 0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, m_pixels );
+    for( long y = 0; y < m_height; y++ )
+        memcpy( dest + y * stride, m_pixels + (m_height - 1 - y) * stride, stride );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: putChunk()
+// desc: one png chunk: length, type, data, crc of type + data
+//-----------------------------------------------------------------------------
+static void putChunk( FILE * f, const char * type, const unsigned char * data,
+                      unsigned long size )
+{
+    unsigned char be[4] = { (unsigned char)(size >> 24), (unsigned char)(size >> 16),
+                            (unsigned char)(size >> 8), (unsigned char)size };
+    fwrite( be, 1, 4, f );
+    fwrite( type, 1, 4, f );
+    if( size ) fwrite( data, 1, size, f );
+
+    unsigned long crc = crc32( 0, (const Bytef *)type, 4 );
+    if( size ) crc = crc32( crc, data, size );
+    be[0] = crc >> 24; be[1] = crc >> 16; be[2] = crc >> 8; be[3] = crc;
+    fwrite( be, 1, 4, f );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: writePng()
+// desc: 8-bit RGBA png; every row uses the "up" filter, which is cheap and
+//       lets zlib's fastest level compress flat visuals well
+//-----------------------------------------------------------------------------
+bool XOffscreen::writePng( const char * path, const unsigned char * rgba,
+                           long width, long height )
+{
+    long stride = width * 4;
+    unsigned long rawSize = (stride + 1) * height;
+    unsigned char * raw = new unsigned char[rawSize];
+    for( long y = 0; y < height; y++ )
+    {
+        unsigned char * out = raw + y * (stride + 1);
+        const unsigned char * row = rgba + y * stride;
+        if( y == 0 )
+        {
+            out[0] = 0;
+            memcpy( out + 1, row, stride );
+            continue;
+        }
+        const unsigned char * above = row - stride;
+        out[0] = 2;
+        for( long i = 0; i < stride; i++ )
+            out[i+1] = row[i] - above[i];
+    }
+
+    uLongf packedSize = compressBound( rawSize );
+    unsigned char * packed = new unsigned char[packedSize];
+    int err = compress2( packed, &packedSize, raw, rawSize, Z_BEST_SPEED );
+    delete [] raw;
+    if( err != Z_OK )
+    {
+        delete [] packed;
+        return false;
+    }
+
+    FILE * f = fopen( path, "wb" );
+    if( !f )
+    {
+        delete [] packed;
+        return false;
+    }
+
+    static const unsigned char signature[8] = { 137, 'P', 'N', 'G', 13, 10, 26, 10 };
+    unsigned char ihdr[13] = {
+        (unsigned char)(width >> 24), (unsigned char)(width >> 16),
+        (unsigned char)(width >> 8), (unsigned char)width,
+        (unsigned char)(height >> 24), (unsigned char)(height >> 16),
+        (unsigned char)(height >> 8), (unsigned char)height,
+        8, 6, 0, 0, 0 // 8 bits, truecolor + alpha, deflate, no interlace
+    };
+    fwrite( signature, 1, 8, f );
+    putChunk( f, "IHDR", ihdr, 13 );
+    putChunk( f, "IDAT", packed, packedSize );
+    putChunk( f, "IEND", NULL, 0 );
+    delete [] packed;
+
+    bool ok = !ferror( f );
+    return fclose( f ) == 0 && ok;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: writeRgba()
+// desc: headerless width x height x 4 bytes
+//-----------------------------------------------------------------------------
+bool XOffscreen::writeRgba( const char * path, const unsigned char * rgba,
+                            long width, long height )
+{
+    FILE * f = fopen( path, "wb" );
+    if( !f ) return false;
+
+    bool ok = fwrite( rgba, 4 * width, height, f ) == (size_t)height;
+    return fclose( f ) == 0 && ok;
+}
@@ -0,0 +1,71 @@
+//-----------------------------------------------------------------------------
+// name: x-offscreen.h
+// desc: windowless software GL context and frame image writers
+//
+//   XOffscreen creates a GL context that needs no display server (EGL on
+//   linux, CGL on mac), makes it current and binds a framebuffer object of
+//   the requested size, so the usual fixed-function drawing code renders
+//   into memory.  read() copies the finished frame out as top-down RGBA,
+//   which writePng() / writeRgba() put on disk.
+//-----------------------------------------------------------------------------
+#ifndef __MCD_X_OFFSCREEN_H__
+#define __MCD_X_OFFSCREEN_H__
+
+#include <stddef.h>
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: class XOffscreen
+// desc: offscreen rendering target
+//-----------------------------------------------------------------------------
+class XOffscreen
+{
+public:
+    XOffscreen();
+    ~XOffscreen();
+
+public:
+    // create the context and a width x height framebuffer, and make both
+    // current on the calling thread
+    bool init( long width, long height );
+    // release everything
+    void cleanup();
+
+public:
+    // wait for rendering and copy the frame out, top row first;
+    // dest holds width * height * 4 bytes
+    void read( unsigned char * dest );
+    long width() const { return m_width; }
+    long height() const { return m_height; }
+
+public:
+    // RGBA, top row first
+    static bool writePng( const char * path, const unsigned char * rgba,
+                          long width, long height );
+    static bool writeRgba( const char * path, const unsigned char * rgba,
+                           long width, long height );
+
+private:
+    XOffscreen( const XOffscreen & );
+    XOffscreen & operator =( const XOffscreen & );
+
+private:
+    long m_width;
+    long m_height;
+    // platform context handles
+    void * m_display;
+    void * m_context;
+    // framebuffer object and its color/depth renderbuffers
+    unsigned int m_fbo;
+    unsigned int m_color;
+    unsigned int m_depth;
+    // one bottom-up frame from glReadPixels
+    unsigned char * m_pixels;
+};
+
+
+
+
+#endif
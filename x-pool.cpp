@@ -0,0 +1,213 @@
+//-----------------------------------------------------------------------------
+// name: x-pool.cpp
+// desc: persistent worker pool with work stealing
+//-----------------------------------------------------------------------------
+#include "x-pool.h"
+#include "x-def.h"
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: XWorkPool()
+// desc: constructor
+//-----------------------------------------------------------------------------
+XWorkPool::XWorkPool()
+    : m_numWorkers( 1 ), m_shares( NULL ), m_generation( 0 ), m_quit( false ),
+      m_task( NULL ), m_data( NULL ), m_busy( 0 )
+{ }
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: ~XWorkPool()
+// desc: destructor
+//-----------------------------------------------------------------------------
+XWorkPool::~XWorkPool()
+{
+    cleanup();
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: init()
+// desc: start numWorkers - 1 helper threads
+//-----------------------------------------------------------------------------
+bool XWorkPool::init( int numWorkers )
+{
+    cleanup();
+
+    if( numWorkers <= 0 )
+        numWorkers = (int)std::thread::hardware_concurrency();
+    if( numWorkers <= 0 )
+        numWorkers = 1;
+
+    m_numWorkers = numWorkers;
+    m_shares = new Share[numWorkers];
+    for( int i = 0; i < numWorkers; i++ )
+        m_shares[i].range.store( 0 );
+
+    m_quit = false;
+    for( int i = 1; i < numWorkers; i++ )
+        m_threads.push_back( std::thread( &XWorkPool::threadLoop, this, i ) );
+
+    return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: cleanup()
+// desc: stop and join helper threads
+//-----------------------------------------------------------------------------
+void XWorkPool::cleanup()
+{
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    for( size_t i = 0; i < m_threads.size(); i++ )
+        m_threads[i].join();
+    m_threads.clear();
+
+    SAFE_DELETE_ARRAY( m_shares );
+    m_numWorkers = 1;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: run()
+// desc: deal chunks out evenly, wake the helpers, work, wait
+//-----------------------------------------------------------------------------
+void XWorkPool::run( long numChunks, Task task, void * data )
+{
+    // not worth waking anybody
+    if( m_numWorkers == 1 || numChunks <= 1 )
+    {
+        for( long c = 0; c < numChunks; c++ )
+            task( c, 0, data );
+        return;
+    }
+
+    for( int w = 0; w < m_numWorkers; w++ )
+    {
+        uint64_t begin = (uint64_t)(numChunks * w / m_numWorkers);
+        uint64_t end = (uint64_t)(numChunks * (w+1) / m_numWorkers);
+        m_shares[w].range.store( begin | (end << 32), std::memory_order_relaxed );
+    }
+
+    m_task = task;
+    m_data = data;
+    m_busy.store( m_numWorkers - 1 );
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_generation++;
+    }
+    m_wake.notify_all();
+
+    // the caller is worker 0
+    work( 0 );
+
+    // wait for the helpers to drain (all chunks are taken by now)
+    while( m_busy.load( std::memory_order_acquire ) > 0 )
+        std::this_thread::yield();
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: threadLoop()
+// desc: helper thread body; sleeps between jobs
+//-----------------------------------------------------------------------------
+void XWorkPool::threadLoop( int worker )
+{
+    unsigned long seen = 0;
+
+    while( true )
+    {
+        {
+            std::unique_lock<std::mutex> lock( m_mutex );
+            m_wake.wait( lock, [&]{ return m_quit || m_generation != seen; } );
+            if( m_quit ) return;
+            seen = m_generation;
+        }
+
+        work( worker );
+        m_busy.fetch_sub( 1, std::memory_order_release );
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: work()
+// desc: own chunks first, then steal until nothing is left anywhere
+//-----------------------------------------------------------------------------
+void XWorkPool::work( int worker )
+{
+    long chunk;
+    while( take( worker, &chunk ) || steal( worker, &chunk ) )
+        m_task( chunk, worker, m_data );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: take()
+// desc: pop from the front of our own share
+//-----------------------------------------------------------------------------
+bool XWorkPool::take( int worker, long * chunk )
+{
+    std::atomic<uint64_t> & range = m_shares[worker].range;
+    uint64_t r = range.load( std::memory_order_acquire );
+    while( true )
+    {
+        uint64_t begin = r & 0xffffffffULL, end = r >> 32;
+        if( begin >= end ) return false;
+        if( range.compare_exchange_weak( r, (begin + 1) | (end << 32),
+                                         std::memory_order_acq_rel ) )
+        {
+            *chunk = (long)begin;
+            return true;
+        }
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: steal()
+// desc: pop from the back of somebody else's share
+//-----------------------------------------------------------------------------
+bool XWorkPool::steal( int worker, long * chunk )
+{
+    for( int i = 1; i < m_numWorkers; i++ )
+    {
+        std::atomic<uint64_t> & range = m_shares[(worker + i) % m_numWorkers].range;
+        uint64_t r = range.load( std::memory_order_acquire );
+        while( true )
+        {
+            uint64_t begin = r & 0xffffffffULL, end = r >> 32;
+            if( begin >= end ) break;
+            if( range.compare_exchange_weak( r, begin | ((end - 1) << 32),
+                                             std::memory_order_acq_rel ) )
+            {
+                *chunk = (long)(end - 1);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,81 @@
+//-----------------------------------------------------------------------------
+// name: x-pool.h
+// desc: persistent worker pool with work stealing
+//
+//   run() splits a job into numbered chunks and hands each worker an even
+//   share up front.  a worker takes chunks from the front of its own
+//   share; once that is empty it steals from the back of the others'.
+//   the calling thread works too, and run() returns when every chunk is
+//   done.  which thread ran a chunk is never visible to the task, so
+//   tasks that keep per-chunk state stay deterministic.
+//-----------------------------------------------------------------------------
+#ifndef __MCD_X_POOL_H__
+#define __MCD_X_POOL_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: class XWorkPool
+// desc: fork-join over chunk indices
+//-----------------------------------------------------------------------------
+class XWorkPool
+{
+public:
+    // called once per chunk; worker is in [0, numWorkers())
+    typedef void (* Task)( long chunk, int worker, void * data );
+
+public:
+    XWorkPool();
+    ~XWorkPool();
+
+public:
+    // numWorkers counts the calling thread; <= 0 means one per core
+    bool init( int numWorkers = 0 );
+    // stop and join the threads
+    void cleanup();
+    // run task for every chunk in [0, numChunks); blocks until done
+    void run( long numChunks, Task task, void * data );
+    // total workers including the caller
+    int numWorkers() const { return m_numWorkers; }
+
+private:
+    XWorkPool( const XWorkPool & );
+    XWorkPool & operator =( const XWorkPool & );
+
+private:
+    void threadLoop( int worker );
+    void work( int worker );
+    bool take( int worker, long * chunk );
+    bool steal( int worker, long * chunk );
+
+private:
+    // a worker's share: begin in the low 32 bits, end in the high 32
+    struct alignas(64) Share { std::atomic<uint64_t> range; };
+
+    int m_numWorkers;
+    Share * m_shares;
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    unsigned long m_generation;
+    bool m_quit;
+
+    Task m_task;
+    void * m_data;
+    // helper threads that have not finished the current job
+    std::atomic<int> m_busy;
+};
+
+
+
+
+#endif
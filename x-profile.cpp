@@ -0,0 +1,237 @@
+//-----------------------------------------------------------------------------
+// name: x-profile.cpp
+// desc: stage timers with lock-free latency histograms
+//-----------------------------------------------------------------------------
+#include "x-profile.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: XProfiler()
+// desc: constructor
+//-----------------------------------------------------------------------------
+XProfiler::XProfiler()
+    : m_numStages( 0 )
+{
+    for( int s = 0; s < XPROFILE_MAX_STAGES; s++ )
+        m_stages[s].name = NULL;
+    reset();
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: add()
+// desc: register a stage
+//-----------------------------------------------------------------------------
+int XProfiler::add( const char * name )
+{
+    if( m_numStages == XPROFILE_MAX_STAGES ) return -1;
+    m_stages[m_numStages].name = name;
+    return m_numStages++;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: record()
+// desc: count one duration; plain relaxed adds, max by compare-exchange
+//-----------------------------------------------------------------------------
+void XProfiler::record( int stage, uint64_t ns )
+{
+    Stage & s = m_stages[stage];
+    s.count.fetch_add( 1, std::memory_order_relaxed );
+    s.total.fetch_add( ns, std::memory_order_relaxed );
+    s.buckets[bucket( ns )].fetch_add( 1, std::memory_order_relaxed );
+
+    uint64_t m = s.max.load( std::memory_order_relaxed );
+    while( ns > m && !s.max.compare_exchange_weak( m, ns, std::memory_order_relaxed ) );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: reset()
+// desc: zero every stage
+//-----------------------------------------------------------------------------
+void XProfiler::reset()
+{
+    for( int s = 0; s < XPROFILE_MAX_STAGES; s++ )
+    {
+        m_stages[s].count.store( 0, std::memory_order_relaxed );
+        m_stages[s].total.store( 0, std::memory_order_relaxed );
+        m_stages[s].max.store( 0, std::memory_order_relaxed );
+        for( int b = 0; b < XPROFILE_BUCKETS; b++ )
+            m_stages[s].buckets[b].store( 0, std::memory_order_relaxed );
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: now()
+// desc: monotonic nanoseconds
+//-----------------------------------------------------------------------------
+uint64_t XProfiler::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: bucket()
+// desc: exact below 2^SUB_BITS ns; above, the top SUB_BITS bits after the
+//       leading one pick one of 2^SUB_BITS buckets in that power of two
+//-----------------------------------------------------------------------------
+int XProfiler::bucket( uint64_t ns )
+{
+    const uint64_t top = (2ULL << XPROFILE_MAX_LOG2) - 1;
+    if( ns < (1 << XPROFILE_SUB_BITS) ) return (int)ns;
+    if( ns > top ) ns = top;
+
+    int e = 63 - __builtin_clzll( ns );
+    int sub = (int)(ns >> (e - XPROFILE_SUB_BITS)) & ((1 << XPROFILE_SUB_BITS) - 1);
+    return ((e - XPROFILE_SUB_BITS + 1) << XPROFILE_SUB_BITS) + sub;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: bucketMid()
+// desc: the duration a bucket stands for
+//-----------------------------------------------------------------------------
+double XProfiler::bucketMid( int b )
+{
+    if( b < (1 << XPROFILE_SUB_BITS) ) return b;
+
+    int e = (b >> XPROFILE_SUB_BITS) + XPROFILE_SUB_BITS - 1;
+    int sub = b & ((1 << XPROFILE_SUB_BITS) - 1);
+    double width = ldexp( 1.0, e - XPROFILE_SUB_BITS );
+    return ((1 << XPROFILE_SUB_BITS) + sub) * width + width / 2;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: percentile()
+// desc: walk the histogram to the bucket holding rank p
+//-----------------------------------------------------------------------------
+double XProfiler::percentile( int stage, double p ) const
+{
+    const Stage & s = m_stages[stage];
+    // count the buckets themselves: count may run ahead of them mid-record
+    uint64_t n = 0;
+    for( int b = 0; b < XPROFILE_BUCKETS; b++ )
+        n += s.buckets[b].load( std::memory_order_relaxed );
+    if( n == 0 ) return 0;
+
+    uint64_t rank = (uint64_t)ceil( p / 100.0 * n );
+    if( rank < 1 ) rank = 1;
+    uint64_t seen = 0;
+    int b = 0;
+    for( ; b < XPROFILE_BUCKETS - 1; b++ )
+    {
+        seen += s.buckets[b].load( std::memory_order_relaxed );
+        if( seen >= rank ) break;
+    }
+
+    // never report more than was ever seen
+    double mid = bucketMid( b );
+    double top = (double)max( stage );
+    return mid < top ? mid : top;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: write()
+// desc: csv or json by extension
+//-----------------------------------------------------------------------------
+bool XProfiler::write( const char * path ) const
+{
+    size_t len = strlen( path );
+    if( len >= 5 && !strcmp( path + len - 5, ".json" ) )
+        return writeJson( path );
+    return writeCsv( path );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: writeCsv()
+// desc: one line per stage, times in microseconds
+//-----------------------------------------------------------------------------
+bool XProfiler::writeCsv( const char * path ) const
+{
+    FILE * f = fopen( path, "w" );
+    if( !f ) return false;
+
+    fprintf( f, "stage,count,mean_us,p50_us,p90_us,p99_us,max_us\n" );
+    for( int s = 0; s < m_numStages; s++ )
+    {
+        uint64_t n = count( s );
+        fprintf( f, "%s,%llu,%.3f,%.3f,%.3f,%.3f,%.3f\n", name( s ),
+                 (unsigned long long)n, n ? total( s ) / 1000.0 / n : 0.0,
+                 percentile( s, 50 ) / 1000, percentile( s, 90 ) / 1000,
+                 percentile( s, 99 ) / 1000, max( s ) / 1000.0 );
+    }
+
+    bool ok = !ferror( f );
+    return fclose( f ) == 0 && ok;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: writeJson()
+// desc: summary plus the non-empty buckets, times in microseconds
+//-----------------------------------------------------------------------------
+bool XProfiler::writeJson( const char * path ) const
+{
+    FILE * f = fopen( path, "w" );
+    if( !f ) return false;
+
+    fprintf( f, "{\n  \"stages\": [\n" );
+    for( int s = 0; s < m_numStages; s++ )
+    {
+        uint64_t n = count( s );
+        fprintf( f, "    { \"stage\": \"%s\", \"count\": %llu, \"mean_us\": %.3f, "
+                 "\"p50_us\": %.3f, \"p90_us\": %.3f, \"p99_us\": %.3f, "
+                 "\"max_us\": %.3f,\n      \"histogram_us\": [",
+                 name( s ), (unsigned long long)n, n ? total( s ) / 1000.0 / n : 0.0,
+                 percentile( s, 50 ) / 1000, percentile( s, 90 ) / 1000,
+                 percentile( s, 99 ) / 1000, max( s ) / 1000.0 );
+        // [bucket midpoint, count] pairs
+        bool first = true;
+        for( int b = 0; b < XPROFILE_BUCKETS; b++ )
+        {
+            uint64_t c = m_stages[s].buckets[b].load( std::memory_order_relaxed );
+            if( !c ) continue;
+            fprintf( f, "%s[%.3f, %llu]", first ? "" : ", ", bucketMid( b ) / 1000,
+                     (unsigned long long)c );
+            first = false;
+        }
+        fprintf( f, "] }%s\n", s + 1 < m_numStages ? "," : "" );
+    }
+    fprintf( f, "  ]\n}\n" );
+
+    bool ok = !ferror( f );
+    return fclose( f ) == 0 && ok;
+}
@@ -0,0 +1,117 @@
+//-----------------------------------------------------------------------------
+// name: x-profile.h
+// desc: stage timers with lock-free latency histograms
+//
+//   each stage keeps a count, a total, a max and a log-linear histogram
+//   (8 buckets per power of two, so any percentile is within 12.5%).
+//   record() is a handful of relaxed atomic adds: any thread may record
+//   into any stage at any time, the audio callback included, and readers
+//   (the HUD, the dump at exit) never block writers.  stages are
+//   registered with add() once, before anything records.
+//-----------------------------------------------------------------------------
+#ifndef __MCD_X_PROFILE_H__
+#define __MCD_X_PROFILE_H__
+
+#include <stdint.h>
+#include <atomic>
+
+// most stages one profiler holds
+#define XPROFILE_MAX_STAGES 32
+// sub-buckets per power of two, as a shift
+#define XPROFILE_SUB_BITS 3
+// longest duration kept apart, as a power of two in ns (~18 minutes)
+#define XPROFILE_MAX_LOG2 40
+#define XPROFILE_BUCKETS ((XPROFILE_MAX_LOG2 - XPROFILE_SUB_BITS + 2) << XPROFILE_SUB_BITS)
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: class XProfiler
+// desc: named stages, each a latency histogram in nanoseconds
+//-----------------------------------------------------------------------------
+class XProfiler
+{
+public:
+    XProfiler();
+
+public:
+    // register a stage; returns its index (stages number from 0 in the
+    // order added), or -1 if full.  not thread safe: call before recording
+    int add( const char * name );
+    // add one duration; lock-free, any thread
+    void record( int stage, uint64_t ns );
+    // clear every stage (counts are not atomic as a group)
+    void reset();
+    // monotonic clock in nanoseconds
+    static uint64_t now();
+
+public:
+    int numStages() const { return m_numStages; }
+    const char * name( int stage ) const { return m_stages[stage].name; }
+    uint64_t count( int stage ) const
+    { return m_stages[stage].count.load( std::memory_order_relaxed ); }
+    uint64_t total( int stage ) const
+    { return m_stages[stage].total.load( std::memory_order_relaxed ); }
+    uint64_t max( int stage ) const
+    { return m_stages[stage].max.load( std::memory_order_relaxed ); }
+    // p in [0, 100]; midpoint of the bucket holding it (at most max()),
+    // 0 if empty
+    double percentile( int stage, double p ) const;
+
+public:
+    // one row per stage; format by extension (.json, anything else csv)
+    bool write( const char * path ) const;
+    bool writeCsv( const char * path ) const;
+    bool writeJson( const char * path ) const;
+
+private:
+    XProfiler( const XProfiler & );
+    XProfiler & operator =( const XProfiler & );
+
+    static int bucket( uint64_t ns );
+    static double bucketMid( int b );
+
+private:
+    struct Stage
+    {
+        const char * name;
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> total;
+        std::atomic<uint64_t> max;
+        std::atomic<uint64_t> buckets[XPROFILE_BUCKETS];
+    };
+
+    Stage m_stages[XPROFILE_MAX_STAGES];
+    int m_numStages;
+};
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: class XScopedTimer
+// desc: records the lifetime of the enclosing scope into one stage
+//-----------------------------------------------------------------------------
+class XScopedTimer
+{
+public:
+    XScopedTimer( XProfiler & profiler, int stage )
+        : m_profiler( profiler ), m_stage( stage ), m_start( XProfiler::now() ) { }
+    ~XScopedTimer()
+    { m_profiler.record( m_stage, XProfiler::now() - m_start ); }
+
+private:
+    XScopedTimer( const XScopedTimer & );
+    XScopedTimer & operator =( const XScopedTimer & );
+
+private:
+    XProfiler & m_profiler;
+    int m_stage;
+    uint64_t m_start;
+};
+
+
+
+
+#endif
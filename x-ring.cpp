@@ -0,0 +1,199 @@
+//-----------------------------------------------------------------------------
+// name: x-ring.cpp
+// desc: lock-free single-producer/single-consumer ring of sample blocks
+//-----------------------------------------------------------------------------
+#include "x-ring.h"
+#include "x-def.h"
+#include <string.h>
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: XBlockRing()
+// desc: constructor
+//-----------------------------------------------------------------------------
+XBlockRing::XBlockRing()
+    : m_data( NULL ), m_frames( NULL ), m_seqs( NULL ), m_numBlocks( 0 ),
+      m_mask( 0 ), m_maxFrames( 0 ), m_numChannels( 0 ),
+      m_write( 0 ), m_nextSeq( 0 ), m_overruns( 0 ), m_read( 0 )
+{ }
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: ~XBlockRing()
+// desc: destructor
+//-----------------------------------------------------------------------------
+XBlockRing::~XBlockRing()
+{
+    cleanup();
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: init()
+// desc: allocate storage; must be called before the stream starts
+//-----------------------------------------------------------------------------
+bool XBlockRing::init( unsigned long numBlocks, unsigned long maxFrames,
+                       unsigned long numChannels )
+{
+    cleanup();
+    if( numBlocks < 2 || maxFrames == 0 || numChannels == 0 )
+        return false;
+
+    // round up to power of 2 so indices can be masked
+    unsigned long n = 2;
+    while( n < numBlocks ) n <<= 1;
+
+    m_numBlocks = n;
+    m_mask = n - 1;
+    m_maxFrames = maxFrames;
+    m_numChannels = numChannels;
+    m_data = new float[n * maxFrames * numChannels];
+    m_frames = new unsigned long[n];
+    m_seqs = new unsigned long long[n];
+    memset( m_data, 0, sizeof(float) * n * maxFrames * numChannels );
+    memset( m_frames, 0, sizeof(unsigned long) * n );
+    memset( m_seqs, 0, sizeof(unsigned long long) * n );
+
+    m_write.store( 0 );
+    m_read.store( 0 );
+    m_nextSeq.store( 0 );
+    m_overruns.store( 0 );
+
+    return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: cleanup()
+// desc: release storage
+//-----------------------------------------------------------------------------
+void XBlockRing::cleanup()
+{
+    SAFE_DELETE_ARRAY( m_data );
+    SAFE_DELETE_ARRAY( m_frames );
+    SAFE_DELETE_ARRAY( m_seqs );
+    m_numBlocks = m_mask = m_maxFrames = m_numChannels = 0;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: push()
+// desc: producer; copy a block in, or drop it if the consumer is behind
+//-----------------------------------------------------------------------------
+bool XBlockRing::push( const float * frames, unsigned long numFrames )
+{
+    unsigned long long seq = m_nextSeq.load( std::memory_order_relaxed );
+    m_nextSeq.store( seq + 1, std::memory_order_relaxed );
+
+    unsigned long w = m_write.load( std::memory_order_relaxed );
+    unsigned long r = m_read.load( std::memory_order_acquire );
+    if( w - r >= m_numBlocks )
+    {
+        // full: never wait on the audio thread
+        m_overruns.store( m_overruns.load( std::memory_order_relaxed ) + 1,
+                          std::memory_order_relaxed );
+        return false;
+    }
+
+    if( numFrames > m_maxFrames ) numFrames = m_maxFrames;
+    unsigned long slot = w & m_mask;
+    float * dest = m_data + slot * m_maxFrames * m_numChannels;
+    if( frames ) memcpy( dest, frames, sizeof(float) * numFrames * m_numChannels );
+    else memset( dest, 0, sizeof(float) * numFrames * m_numChannels );
+    m_frames[slot] = numFrames;
+    m_seqs[slot] = seq;
+
+    // publish
+    m_write.store( w + 1, std::memory_order_release );
+    return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: space()
+// desc: producer; free blocks
+//-----------------------------------------------------------------------------
+unsigned long XBlockRing::space() const
+{
+    unsigned long w = m_write.load( std::memory_order_relaxed );
+    unsigned long r = m_read.load( std::memory_order_acquire );
+    return m_numBlocks - (w - r);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: available()
+// desc: consumer; number of blocks waiting
+//-----------------------------------------------------------------------------
+unsigned long XBlockRing::available() const
+{
+    unsigned long w = m_write.load( std::memory_order_acquire );
+    unsigned long r = m_read.load( std::memory_order_relaxed );
+    return w - r;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: peek()
+// desc: consumer; oldest unread block, or NULL if empty
+//-----------------------------------------------------------------------------
+const float * XBlockRing::peek( unsigned long * numFrames,
+                                unsigned long long * seq ) const
+{
+    unsigned long r = m_read.load( std::memory_order_relaxed );
+    unsigned long w = m_write.load( std::memory_order_acquire );
+    if( r == w ) return NULL;
+
+    unsigned long slot = r & m_mask;
+    if( numFrames ) *numFrames = m_frames[slot];
+    if( seq ) *seq = m_seqs[slot];
+    return m_data + slot * m_maxFrames * m_numChannels;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: release()
+// desc: consumer; hand the oldest block back to the producer
+//-----------------------------------------------------------------------------
+void XBlockRing::release()
+{
+    unsigned long r = m_read.load( std::memory_order_relaxed );
+    if( r == m_write.load( std::memory_order_acquire ) ) return;
+    m_read.store( r + 1, std::memory_order_release );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: pop()
+// desc: consumer; copy oldest block out and release it
+//-----------------------------------------------------------------------------
+unsigned long XBlockRing::pop( float * dest, unsigned long long * seq )
+{
+    unsigned long numFrames = 0;
+    const float * src = peek( &numFrames, seq );
+    if( !src ) return 0;
+
+    memcpy( dest, src, sizeof(float) * numFrames * m_numChannels );
+    release();
+    return numFrames;
+}
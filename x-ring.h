@@ -0,0 +1,87 @@
+//-----------------------------------------------------------------------------
+// name: x-ring.h
+// desc: lock-free single-producer/single-consumer ring of sample blocks
+//
+//   the audio callback is the only producer and the render/analysis loop is
+//   the only consumer.  push() never blocks and never allocates: when the
+//   ring is full the block is dropped and the overrun counter is bumped.
+//   every pushed block (dropped or not) is stamped with a sequence number,
+//   so the consumer can tell exactly how many blocks it missed.
+//-----------------------------------------------------------------------------
+#ifndef __MCD_X_RING_H__
+#define __MCD_X_RING_H__
+
+#include <stddef.h>
+#include <atomic>
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: class XBlockRing
+// desc: wait-free SPSC ring of fixed-size interleaved float blocks
+//-----------------------------------------------------------------------------
+class XBlockRing
+{
+public:
+    XBlockRing();
+    ~XBlockRing();
+
+public:
+    // allocate numBlocks (rounded up to power of 2) blocks of maxFrames
+    bool init( unsigned long numBlocks, unsigned long maxFrames,
+               unsigned long numChannels = 1 );
+    // release memory
+    void cleanup();
+
+public: // producer side (audio thread)
+    // copy one block in; returns false (and counts an overrun) if full
+    bool push( const float * frames, unsigned long numFrames );
+    // number of blocks that can be pushed without an overrun
+    unsigned long space() const;
+
+public: // consumer side (render thread)
+    // number of blocks ready to be consumed
+    unsigned long available() const;
+    // look at the oldest block without consuming it; NULL if empty
+    const float * peek( unsigned long * numFrames = NULL,
+                        unsigned long long * seq = NULL ) const;
+    // consume the block returned by peek()
+    void release();
+    // copy the oldest block out and consume it; returns frames copied
+    unsigned long pop( float * dest, unsigned long long * seq = NULL );
+
+public: // stats (safe from either side)
+    unsigned long long overruns() const
+    { return m_overruns.load( std::memory_order_relaxed ); }
+    unsigned long long produced() const
+    { return m_nextSeq.load( std::memory_order_relaxed ); }
+    unsigned long capacity() const { return m_numBlocks; }
+    unsigned long maxFrames() const { return m_maxFrames; }
+    unsigned long numChannels() const { return m_numChannels; }
+
+private:
+    XBlockRing( const XBlockRing & );
+    XBlockRing & operator =( const XBlockRing & );
+
+private:
+    float * m_data;
+    unsigned long * m_frames;
+    unsigned long long * m_seqs;
+    unsigned long m_numBlocks;
+    unsigned long m_mask;
+    unsigned long m_maxFrames;
+    unsigned long m_numChannels;
+
+    // written by producer only
+    alignas(64) std::atomic<unsigned long> m_write;
+    std::atomic<unsigned long long> m_nextSeq;
+    std::atomic<unsigned long long> m_overruns;
+    // written by consumer only
+    alignas(64) std::atomic<unsigned long> m_read;
+};
+
+
+
+
+#endif
@@ -0,0 +1,36 @@
+//-----------------------------------------------------------------------------
+// name: x-source.h
+// desc: offline sample sources that stand in for the audio device
+//-----------------------------------------------------------------------------
+#ifndef __MCD_X_SOURCE_H__
+#define __MCD_X_SOURCE_H__
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: class XSource
+// desc: anything that can be read block by block into the capture ring
+//-----------------------------------------------------------------------------
+class XSource
+{
+public:
+    virtual ~XSource() { }
+
+public:
+    // write numFrames frames of numChannels interleaved floats to dest;
+    // past the end the rest is zero-filled; returns frames of real signal
+    virtual unsigned long read( float * dest, unsigned long numFrames,
+                                unsigned long numChannels ) = 0;
+    // frames per second
+    virtual unsigned long sampleRate() const = 0;
+    // total frames, 0 if the source never ends
+    virtual unsigned long long length() const = 0;
+    // frames read so far
+    virtual unsigned long long position() const = 0;
+};
+
+
+
+
+#endif
@@ -0,0 +1,84 @@
+//-----------------------------------------------------------------------------
+// name: x-spectrogram.cpp
+// desc: circular spectrogram history
+//-----------------------------------------------------------------------------
+#include "x-spectrogram.h"
+#include "x-def.h"
+#include <string.h>
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: XSpectrogram()
+// desc: constructor
+//-----------------------------------------------------------------------------
+XSpectrogram::XSpectrogram()
+    : m_data( NULL ), m_numRows( 0 ), m_numBins( 0 ), m_numChannels( 0 ),
+      m_head( 0 ), m_pushes( 0 )
+{ }
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: ~XSpectrogram()
+// desc: destructor
+//-----------------------------------------------------------------------------
+XSpectrogram::~XSpectrogram()
+{
+    cleanup();
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: init()
+// desc: allocate the history, all zeros
+//-----------------------------------------------------------------------------
+bool XSpectrogram::init( unsigned long numRows, unsigned long numBins,
+                         unsigned long numChannels )
+{
+    cleanup();
+    if( numRows == 0 || numBins == 0 || numChannels == 0 )
+        return false;
+
+    m_numRows = numRows;
+    m_numBins = numBins;
+    m_numChannels = numChannels;
+    m_head = 0;
+    m_pushes = 0;
+    m_data = new float[numChannels * numRows * numBins];
+    memset( m_data, 0, sizeof(float) * numChannels * numRows * numBins );
+
+    return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: cleanup()
+// desc: release memory
+//-----------------------------------------------------------------------------
+void XSpectrogram::cleanup()
+{
+    SAFE_DELETE_ARRAY( m_data );
+    m_numRows = m_numBins = m_numChannels = m_head = 0;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: push()
+// desc: recycle the oldest row of every channel as the newest; O(1),
+//       caller fills them
+//-----------------------------------------------------------------------------
+float * XSpectrogram::push()
+{
+    m_head = m_head == 0 ? m_numRows - 1 : m_head - 1;
+    m_pushes++;
+    return m_data + m_head * m_numBins;
+}
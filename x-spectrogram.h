@@ -0,0 +1,74 @@
+//-----------------------------------------------------------------------------
+// name: x-spectrogram.h
+// desc: circular spectrogram history
+//
+//   numRows rows of numBins floats per channel, all channels in one
+//   contiguous block (channel-major).  pushing a frame only moves the
+//   head, which every channel shares, so aging the history costs
+//   nothing; rows are addressed by age relative to the head (0 = newest).
+//-----------------------------------------------------------------------------
+#ifndef __MCD_X_SPECTROGRAM_H__
+#define __MCD_X_SPECTROGRAM_H__
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: class XSpectrogram
+// desc: 2d ring of magnitude rows
+//-----------------------------------------------------------------------------
+class XSpectrogram
+{
+public:
+    XSpectrogram();
+    ~XSpectrogram();
+
+public:
+    // allocate numChannels x numRows x numBins, zeroed
+    bool init( unsigned long numRows, unsigned long numBins,
+               unsigned long numChannels = 1 );
+    // release memory
+    void cleanup();
+
+public:
+    // make the oldest row the newest and return it for filling; the
+    // other channels' rows follow channelStride() floats apart
+    float * push();
+    // physical slot of the row with the given age
+    unsigned long slot( unsigned long age ) const
+    { unsigned long s = m_head + age; return s >= m_numRows ? s - m_numRows : s; }
+    // row with the given age (0 = newest)
+    float * row( unsigned long age, unsigned long channel = 0 )
+    { return m_data + channel * channelStride() + slot( age ) * m_numBins; }
+    const float * row( unsigned long age, unsigned long channel = 0 ) const
+    { return m_data + channel * channelStride() + slot( age ) * m_numBins; }
+
+public:
+    unsigned long numRows() const { return m_numRows; }
+    unsigned long numBins() const { return m_numBins; }
+    unsigned long numChannels() const { return m_numChannels; }
+    // floats from one channel's history to the next
+    unsigned long channelStride() const { return m_numRows * m_numBins; }
+    unsigned long head() const { return m_head; }
+    // total rows ever pushed (to find rows changed since a given point)
+    unsigned long long pushes() const { return m_pushes; }
+    // the whole block: channel by channel, row-major by physical slot
+    const float * data() const { return m_data; }
+
+private:
+    XSpectrogram( const XSpectrogram & );
+    XSpectrogram & operator =( const XSpectrogram & );
+
+private:
+    float * m_data;
+    unsigned long m_numRows;
+    unsigned long m_numBins;
+    unsigned long m_numChannels;
+    unsigned long m_head;
+    unsigned long long m_pushes;
+};
+
+
+
+
+#endif
@@ -0,0 +1,197 @@
+//-----------------------------------------------------------------------------
+// name: x-stft.cpp
+// desc: streaming short-time fourier transform
+//-----------------------------------------------------------------------------
+#include "x-stft.h"
+#include "x-pool.h"
+#include "x-def.h"
+#include <string.h>
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: XStft()
+// desc: constructor
+//-----------------------------------------------------------------------------
+XStft::XStft()
+    : m_windowSize( 0 ), m_hopSize( 0 ), m_fftSize( 0 ), m_maxFrames( 0 ),
+      m_numChannels( 0 ), m_windowType( WINDOW_HANN ), m_plan( NULL ), m_window( NULL ),
+      m_history( NULL ), m_writePos( 0 ), m_untilHop( 0 ), m_frames( NULL ),
+      m_numFrames( 0 ), m_transformed( 0 ), m_dropped( 0 )
+{ }
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: ~XStft()
+// desc: destructor
+//-----------------------------------------------------------------------------
+XStft::~XStft()
+{
+    cleanup();
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: init()
+// desc: allocate everything the stream will ever need
+//-----------------------------------------------------------------------------
+bool XStft::init( unsigned long windowSize, unsigned long hopSize,
+                  unsigned long fftSize, unsigned long maxFrames,
+                  int windowType, float beta, unsigned long numChannels )
+{
+    cleanup();
+
+    if( windowSize == 0 || hopSize == 0 || hopSize > windowSize ||
+        fftSize < windowSize || (fftSize & (fftSize-1)) || fftSize < 2 ||
+        maxFrames == 0 || windowType < WINDOW_HANN || windowType > WINDOW_KAISER ||
+        numChannels == 0 )
+        return false;
+
+    m_window = window_cached( windowType, windowSize, beta );
+    if( !m_window ) return false;
+    m_plan = fft_plan_create( fftSize / 2 );
+    if( !m_plan ) return false;
+
+    m_windowSize = windowSize;
+    m_hopSize = hopSize;
+    m_fftSize = fftSize;
+    m_maxFrames = maxFrames;
+    m_numChannels = numChannels;
+    m_windowType = windowType;
+
+    m_history = new float[numChannels * windowSize];
+    memset( m_history, 0, sizeof(float) * numChannels * windowSize );
+    m_frames = new float[numChannels * maxFrames * fftSize];
+    memset( m_frames, 0, sizeof(float) * numChannels * maxFrames * fftSize );
+
+    m_writePos = 0;
+    m_untilHop = hopSize;
+    m_numFrames = 0;
+    m_transformed = 0;
+    m_dropped = 0;
+
+    return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: cleanup()
+// desc: release memory
+//-----------------------------------------------------------------------------
+void XStft::cleanup()
+{
+    fft_plan_destroy( m_plan );
+    m_plan = NULL;
+    m_window = NULL;
+    SAFE_DELETE_ARRAY( m_history );
+    SAFE_DELETE_ARRAY( m_frames );
+    m_windowSize = m_hopSize = m_fftSize = m_maxFrames = m_numChannels = 0;
+    m_numFrames = m_transformed = 0;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: feed()
+// desc: append samples to the histories, cutting a frame every hop
+//-----------------------------------------------------------------------------
+unsigned long XStft::feed( const float * samples, unsigned long numFrames )
+{
+    unsigned long queued = 0;
+
+    while( numFrames > 0 )
+    {
+        // copy up to the next hop boundary or the end of the history
+        unsigned long n = m_untilHop;
+        if( n > numFrames ) n = numFrames;
+        if( n > m_windowSize - m_writePos ) n = m_windowSize - m_writePos;
+
+        if( m_numChannels == 1 )
+            memcpy( m_history + m_writePos, samples, sizeof(float) * n );
+        else
+        {
+            // deinterleave
+            for( unsigned long c = 0; c < m_numChannels; c++ )
+            {
+                float * h = m_history + c * m_windowSize + m_writePos;
+                const float * in = samples + c;
+                for( unsigned long i = 0; i < n; i++ )
+                    h[i] = in[i * m_numChannels];
+            }
+        }
+        samples += n * m_numChannels;
+        numFrames -= n;
+        m_writePos += n;
+        if( m_writePos == m_windowSize ) m_writePos = 0;
+        m_untilHop -= n;
+
+        if( m_untilHop > 0 ) continue;
+        m_untilHop = m_hopSize;
+
+        if( m_numFrames == m_maxFrames )
+        {
+            m_dropped++;
+            continue;
+        }
+
+        // oldest sample sits at m_writePos
+        for( unsigned long c = 0; c < m_numChannels; c++ )
+        {
+            float * dest = (float *)frame( m_numFrames, c );
+            window_copy( dest, m_history + c * m_windowSize, m_windowSize,
+                         m_writePos, m_window, m_windowSize );
+            // zero-pad up to the fft size
+            memset( dest + m_windowSize, 0, sizeof(float) * (m_fftSize - m_windowSize) );
+        }
+
+        m_numFrames++;
+        queued++;
+    }
+
+    return queued;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: transform()
+// desc: batched forward fft of the frames queued since the last call
+//-----------------------------------------------------------------------------
+unsigned long XStft::transform( XWorkPool * pool, unsigned long parallelAbove )
+{
+    if( m_transformed < m_numFrames )
+    {
+        // the plan is read-only, so channels can share it across threads
+        if( pool && m_numChannels > parallelAbove )
+            pool->run( m_numChannels, transformChannel, this );
+        else
+            for( unsigned long c = 0; c < m_numChannels; c++ )
+                transformChannel( c, 0, this );
+        m_transformed = m_numFrames;
+    }
+
+    return m_numFrames;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: transformChannel()
+// desc: one channel's share of transform()
+//-----------------------------------------------------------------------------
+void XStft::transformChannel( long channel, int worker, void * data )
+{
+    XStft * stft = (XStft *)data;
+    fft_plan_rfft_batch( stft->m_plan, (float *)stft->frame( stft->m_transformed, channel ),
+                         stft->m_numFrames - stft->m_transformed, FFT_FORWARD );
+}
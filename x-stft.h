@@ -0,0 +1,121 @@
+//-----------------------------------------------------------------------------
+// name: x-stft.h
+// desc: streaming short-time fourier transform
+//
+//   samples go in through feed() in whatever block size the source
+//   delivers; a frame is cut every hopSize samples from the last
+//   windowSize samples, windowed on the way out of the history (one
+//   fused pass, see window_copy()), zero-padded to fftSize and queued.
+//   transform() runs one batched fft over all queued frames.  all memory
+//   is allocated in init(); nothing is allocated per frame.
+//
+//   with several channels, feed() takes interleaved frames and every
+//   channel keeps its own history and queue, channel after channel in
+//   one block each; all channels cut frames at the same time.  the
+//   per-channel batches are independent, so transform() can spread them
+//   over a work pool.
+//-----------------------------------------------------------------------------
+#ifndef __MCD_X_STFT_H__
+#define __MCD_X_STFT_H__
+
+#include "chuck_fft.h"
+#include <stddef.h>
+
+// transform() with a pool goes parallel above this many channels; below,
+// one channel's batch is too little work to be worth a fork-join
+#define XSTFT_PARALLEL_CHANNELS 2
+
+class XWorkPool;
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: class XStft
+// desc: overlapped stft with independent window, hop and fft sizes
+//-----------------------------------------------------------------------------
+class XStft
+{
+public:
+    XStft();
+    ~XStft();
+
+public:
+    // windowSize <= fftSize, fftSize power of 2, 0 < hopSize <= windowSize;
+    // maxFrames bounds how many frames may queue between transform() calls;
+    // windowType is a WINDOW_* (beta: kaiser only)
+    bool init( unsigned long windowSize, unsigned long hopSize,
+               unsigned long fftSize, unsigned long maxFrames,
+               int windowType = WINDOW_HANN, float beta = 0,
+               unsigned long numChannels = 1 );
+    // release memory
+    void cleanup();
+
+public:
+    // push numFrames interleaved frames (one sample per channel);
+    // returns number of frames queued by this call
+    unsigned long feed( const float * samples, unsigned long numFrames );
+    // fft every queued frame, one batch per channel, the channels spread
+    // over pool if given and there are more than parallelAbove; returns
+    // number of frames
+    unsigned long transform( XWorkPool * pool = NULL,
+                             unsigned long parallelAbove = XSTFT_PARALLEL_CHANNELS );
+    // number of queued frames
+    unsigned long numFrames() const { return m_numFrames; }
+    // spectrum of queued frame i of a channel (fftSize/2 complex, rfft
+    // packing); valid after transform()
+    complex * frame( unsigned long i, unsigned long channel = 0 )
+    { return (complex *)(m_frames + (channel * m_maxFrames + i) * m_fftSize); }
+    // complex values from a frame to the same frame of the next channel
+    unsigned long channelStride() const { return m_maxFrames * m_fftSize / 2; }
+    // drop queued frames (after they have been consumed)
+    void clear() { m_numFrames = 0; m_transformed = 0; }
+
+public:
+    unsigned long windowSize() const { return m_windowSize; }
+    unsigned long hopSize() const { return m_hopSize; }
+    unsigned long fftSize() const { return m_fftSize; }
+    unsigned long numBins() const { return m_fftSize / 2; }
+    unsigned long maxFrames() const { return m_maxFrames; }
+    unsigned long numChannels() const { return m_numChannels; }
+    int windowType() const { return m_windowType; }
+    // frames lost because the queue was full
+    unsigned long long dropped() const { return m_dropped; }
+
+private:
+    XStft( const XStft & );
+    XStft & operator =( const XStft & );
+
+    // XWorkPool task: transform one channel's pending frames
+    static void transformChannel( long channel, int worker, void * data );
+
+private:
+    unsigned long m_windowSize;
+    unsigned long m_hopSize;
+    unsigned long m_fftSize;
+    unsigned long m_maxFrames;
+    unsigned long m_numChannels;
+    int m_windowType;
+
+    // fft plan for fftSize reals
+    fft_plan * m_plan;
+    // analysis window, windowSize long (shared, see window_cached())
+    const float * m_window;
+    // last windowSize input samples per channel, circular (one write
+    // position for all)
+    float * m_history;
+    unsigned long m_writePos;
+    // samples until the next frame is due
+    unsigned long m_untilHop;
+
+    // queued frames, numChannels x maxFrames x fftSize
+    float * m_frames;
+    unsigned long m_numFrames;
+    unsigned long m_transformed;
+    unsigned long long m_dropped;
+};
+
+
+
+
+#endif
@@ -0,0 +1,202 @@
+//-----------------------------------------------------------------------------
+// name: x-synth.cpp
+// desc: deterministic test signal source
+//-----------------------------------------------------------------------------
+#include "x-synth.h"
+#include "x-def.h"
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: XSynth()
+// desc: constructor
+//-----------------------------------------------------------------------------
+XSynth::XSynth()
+    : m_kind( SINE ), m_numFreqs( 0 ), m_period( 0 ), m_gain( 0 ),
+      m_sampleRate( 0 ), m_length( 0 ), m_position( 0 ), m_seed( 0 )
+{
+    memset( m_freqs, 0, sizeof(m_freqs) );
+    memset( m_pink, 0, sizeof(m_pink) );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: init()
+// desc: parse "kind[:arg[:arg...]]"; arguments split on ':' or ','
+//-----------------------------------------------------------------------------
+bool XSynth::init( const char * spec, unsigned long sampleRate,
+                   double seconds, uint64_t seed )
+{
+    if( !spec || sampleRate == 0 || seconds < 0 )
+        return false;
+
+    // kind, then numbers; more than any kind takes is an error, not a
+    // silent truncation
+    size_t nameLen = strcspn( spec, ":" );
+    double args[XSYNTH_MAX_TONES];
+    int numArgs = 0;
+    for( const char * p = spec + nameLen; *p; )
+    {
+        char * end;
+        if( numArgs == XSYNTH_MAX_TONES ) return false;
+        args[numArgs] = strtod( p + 1, &end );
+        if( end == p + 1 ) return false;
+        numArgs++;
+        p = end;
+        if( *p && *p != ':' && *p != ',' ) return false;
+    }
+
+    m_gain = 0.5;
+    m_numFreqs = 0;
+    m_period = 0;
+    if( nameLen == 4 && !strncmp( spec, "sine", 4 ) && numArgs == 1 && args[0] > 0 )
+    {
+        m_kind = SINE;
+        m_freqs[m_numFreqs++] = args[0];
+    }
+    else if( nameLen == 5 && !strncmp( spec, "chord", 5 ) && numArgs > 0 )
+    {
+        m_kind = SINE;
+        for( int i = 0; i < numArgs; i++ )
+        {
+            if( args[i] <= 0 ) return false;
+            m_freqs[m_numFreqs++] = args[i];
+        }
+        m_gain /= numArgs;
+    }
+    else if( nameLen == 5 && !strncmp( spec, "chirp", 5 ) && numArgs == 3 &&
+             args[0] > 0 && args[1] > 0 && args[2] > 0 )
+    {
+        m_kind = CHIRP;
+        m_freqs[m_numFreqs++] = args[0];
+        m_freqs[m_numFreqs++] = args[1];
+        m_period = (unsigned long long)(args[2] * sampleRate);
+        if( m_period == 0 ) return false;
+    }
+    else if( nameLen == 5 && !strncmp( spec, "white", 5 ) && numArgs == 0 )
+        m_kind = WHITE;
+    else if( nameLen == 4 && !strncmp( spec, "pink", 4 ) && numArgs == 0 )
+        m_kind = PINK;
+    else if( nameLen == 7 && !strncmp( spec, "impulse", 7 ) && numArgs == 1 &&
+             args[0] > 0 )
+    {
+        m_kind = IMPULSE;
+        m_gain = 1;
+        m_period = (unsigned long long)(sampleRate / args[0]);
+        if( m_period == 0 ) m_period = 1;
+    }
+    else
+        return false;
+
+    m_sampleRate = sampleRate;
+    m_length = (unsigned long long)(seconds * sampleRate);
+    m_seed = seed;
+    rewind();
+
+    return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: rewind()
+// desc: restart the signal and the noise stream
+//-----------------------------------------------------------------------------
+void XSynth::rewind()
+{
+    m_position = 0;
+    m_random.seed( m_seed );
+    memset( m_pink, 0, sizeof(m_pink) );
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: next()
+// desc: one sample at m_position; phases come from the frame index, so
+//       there is no accumulated drift
+//-----------------------------------------------------------------------------
+inline float XSynth::next()
+{
+    double n = (double)m_position;
+    double sr = (double)m_sampleRate;
+    double out = 0;
+
+    switch( m_kind )
+    {
+        case SINE:
+            for( int i = 0; i < m_numFreqs; i++ )
+                out += sin( TWO_PI * fmod( m_freqs[i] * n / sr, 1.0 ) );
+            break;
+
+        case CHIRP:
+        {
+            // exponential sweep: phase = f0 (e^(kt) - 1) / k cycles
+            double t = (double)(m_position % m_period) / sr;
+            double k = log( m_freqs[1] / m_freqs[0] ) * sr / m_period;
+            double cycles = k != 0 ? m_freqs[0] * (exp( k * t ) - 1) / k
+                                   : m_freqs[0] * t;
+            out = sin( TWO_PI * fmod( cycles, 1.0 ) );
+            break;
+        }
+
+        case WHITE:
+            out = 2.0 * m_random.nextf() - 1.0;
+            break;
+
+        case PINK:
+        {
+            // paul kellet's refined pink filter, about 0.05 dB flat
+            double w = 2.0 * m_random.nextf() - 1.0;
+            double * b = m_pink;
+            b[0] = 0.99886 * b[0] + w * 0.0555179;
+            b[1] = 0.99332 * b[1] + w * 0.0750759;
+            b[2] = 0.96900 * b[2] + w * 0.1538520;
+            b[3] = 0.86650 * b[3] + w * 0.3104856;
+            b[4] = 0.55000 * b[4] + w * 0.5329522;
+            b[5] = -0.7616 * b[5] - w * 0.0168980;
+            out = (b[0] + b[1] + b[2] + b[3] + b[4] + b[5] + b[6] + w * 0.5362) * 0.11;
+            b[6] = w * 0.115926;
+            break;
+        }
+
+        case IMPULSE:
+            out = m_position % m_period == 0 ? 1.0 : 0.0;
+            break;
+    }
+
+    m_position++;
+    return (float)(out * m_gain);
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: read()
+// desc: next numFrames frames, zero past the length
+//-----------------------------------------------------------------------------
+unsigned long XSynth::read( float * dest, unsigned long numFrames,
+                            unsigned long numChannels )
+{
+    unsigned long n = numFrames;
+    if( m_length && n > m_length - m_position ) n = m_length - m_position;
+
+    for( unsigned long i = 0; i < n; i++ )
+    {
+        float v = next();
+        for( unsigned long c = 0; c < numChannels; c++ )
+            dest[i * numChannels + c] = v;
+    }
+
+    memset( dest + n * numChannels, 0, sizeof(float) * (numFrames - n) * numChannels );
+    return n;
+}
@@ -0,0 +1,78 @@
+//-----------------------------------------------------------------------------
+// name: x-synth.h
+// desc: deterministic test signal source
+//
+//   every sample is a function of its frame index (and, for noise, of the
+//   seed), computed in double precision, so the same spec and seed always
+//   give the same bits regardless of how the reads are blocked.
+//
+//   specs:
+//     sine:FREQ                  one sine
+//     chord:FREQ,FREQ,...        equal-level sines (up to XSYNTH_MAX_TONES)
+//     chirp:FROM:TO:SECONDS      exponential sweep, repeating
+//     white                      uniform white noise
+//     pink                       white noise through a -3 dB/octave filter
+//     impulse:PER_SECOND         unit clicks
+//-----------------------------------------------------------------------------
+#ifndef __MCD_X_SYNTH_H__
+#define __MCD_X_SYNTH_H__
+
+#include "x-source.h"
+#include "x-fun.h"
+
+// most tones in one chord
+#define XSYNTH_MAX_TONES 16
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: class XSynth
+// desc: synthetic sample source
+//-----------------------------------------------------------------------------
+class XSynth : public XSource
+{
+public:
+    XSynth();
+
+public:
+    // parse a spec (see above); seconds = 0 never ends; false if invalid
+    bool init( const char * spec, unsigned long sampleRate,
+               double seconds = 0, uint64_t seed = 0 );
+    // back to frame 0, noise included
+    void rewind();
+
+public:
+    // the same signal on every channel
+    virtual unsigned long read( float * dest, unsigned long numFrames,
+                                unsigned long numChannels );
+    virtual unsigned long sampleRate() const { return m_sampleRate; }
+    virtual unsigned long long length() const { return m_length; }
+    virtual unsigned long long position() const { return m_position; }
+
+private:
+    // sample at the current position; advances noise state
+    inline float next();
+
+private:
+    enum Kind { SINE, CHIRP, WHITE, PINK, IMPULSE };
+    Kind m_kind;
+    // sine / chord frequencies; chirp from, to
+    double m_freqs[XSYNTH_MAX_TONES];
+    int m_numFreqs;
+    // chirp sweep length, impulse period, in frames
+    unsigned long long m_period;
+    double m_gain;
+    unsigned long m_sampleRate;
+    unsigned long long m_length;
+    unsigned long long m_position;
+    uint64_t m_seed;
+    XRandom m_random;
+    // pink filter state
+    double m_pink[7];
+};
+
+
+
+
+#endif
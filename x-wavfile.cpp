@@ -0,0 +1,220 @@
+//-----------------------------------------------------------------------------
+// name: x-wavfile.cpp
+// desc: memory-mapped WAV file source
+//-----------------------------------------------------------------------------
+#include "x-wavfile.h"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// format codes
+#define WAV_FORMAT_PCM 1
+#define WAV_FORMAT_FLOAT 3
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+
+
+
+
+// little-endian fields
+static inline unsigned long le16( const unsigned char * p )
+{ return p[0] | (p[1] << 8); }
+static inline unsigned long le32( const unsigned char * p )
+{ return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned long)p[3] << 24); }
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: XWavFile()
+// desc: constructor
+//-----------------------------------------------------------------------------
+XWavFile::XWavFile()
+    : m_map( NULL ), m_mapSize( 0 ), m_data( NULL ), m_sampleRate( 0 ),
+      m_numChannels( 0 ), m_bytes( 0 ), m_float( false ), m_numFrames( 0 ),
+      m_position( 0 )
+{ }
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: ~XWavFile()
+// desc: destructor
+//-----------------------------------------------------------------------------
+XWavFile::~XWavFile()
+{
+    close();
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: open()
+// desc: map the file, walk the chunks, validate the format
+//-----------------------------------------------------------------------------
+bool XWavFile::open( const char * path )
+{
+    close();
+
+    int fd = ::open( path, O_RDONLY );
+    if( fd < 0 ) return false;
+    struct stat st;
+    if( fstat( fd, &st ) < 0 || st.st_size < 12 )
+    {
+        ::close( fd );
+        return false;
+    }
+    void * map = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    // the mapping keeps the file alive
+    ::close( fd );
+    if( map == MAP_FAILED ) return false;
+    m_map = map;
+    m_mapSize = st.st_size;
+    madvise( m_map, m_mapSize, MADV_SEQUENTIAL );
+
+    const unsigned char * p = (const unsigned char *)m_map;
+    const unsigned char * end = p + m_mapSize;
+    if( memcmp( p, "RIFF", 4 ) || memcmp( p + 8, "WAVE", 4 ) )
+    {
+        close();
+        return false;
+    }
+
+    unsigned long format = 0, bits = 0, blockAlign = 0;
+    const unsigned char * data = NULL;
+    unsigned long long dataSize = 0;
+    // chunks are word aligned
+    for( p += 12; p + 8 <= end; )
+    {
+        unsigned long long size = le32( p + 4 );
+        const unsigned char * body = p + 8;
+        if( !memcmp( p, "fmt ", 4 ) && size >= 16 && body + 16 <= end )
+        {
+            format = le16( body );
+            m_numChannels = le16( body + 2 );
+            m_sampleRate = le32( body + 4 );
+            blockAlign = le16( body + 12 );
+            bits = le16( body + 14 );
+            // extensible: the real code leads the subformat guid
+            if( format == WAV_FORMAT_EXTENSIBLE && size >= 26 && body + 26 <= end )
+                format = le16( body + 24 );
+        }
+        else if( !memcmp( p, "data", 4 ) )
+        {
+            data = body;
+            // streamed files may leave the size unset; trust the file length
+            dataSize = size;
+            if( dataSize > (unsigned long long)(end - body) )
+                dataSize = end - body;
+            break;
+        }
+        p = body + size + (size & 1);
+    }
+
+    m_bytes = bits / 8;
+    m_float = format == WAV_FORMAT_FLOAT;
+    bool ok = data && m_numChannels > 0 && m_sampleRate > 0 &&
+              blockAlign == m_numChannels * m_bytes &&
+              ( (format == WAV_FORMAT_PCM && (bits == 16 || bits == 24 || bits == 32)) ||
+                (format == WAV_FORMAT_FLOAT && bits == 32) );
+    if( !ok )
+    {
+        close();
+        return false;
+    }
+
+    m_data = data;
+    m_numFrames = dataSize / blockAlign;
+    m_position = 0;
+
+    return true;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: close()
+// desc: unmap
+//-----------------------------------------------------------------------------
+void XWavFile::close()
+{
+    if( m_map ) munmap( m_map, m_mapSize );
+    m_map = NULL;
+    m_mapSize = 0;
+    m_data = NULL;
+    m_sampleRate = m_numChannels = m_bytes = 0;
+    m_float = false;
+    m_numFrames = m_position = 0;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: sample()
+// desc: decode one sample; the format tests are loop invariant in read()
+//-----------------------------------------------------------------------------
+inline float XWavFile::sample( unsigned long long s ) const
+{
+    const unsigned char * p = m_data + s * m_bytes;
+    switch( m_bytes )
+    {
+        case 2:
+            return (short)le16( p ) * (1.0f / 32768.0f);
+        case 3:
+            // shift into the top of an int to sign-extend
+            return (int)((p[0] << 8) | (p[1] << 16) | ((unsigned)p[2] << 24))
+                   * (1.0f / 2147483648.0f);
+        default:
+            if( m_float )
+            {
+                float f;
+                memcpy( &f, p, 4 );
+                return f;
+            }
+            return (int)le32( p ) * (1.0f / 2147483648.0f);
+    }
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: read()
+// desc: convert the next numFrames frames, zero-filling past the end
+//-----------------------------------------------------------------------------
+unsigned long XWavFile::read( float * dest, unsigned long numFrames,
+                              unsigned long numChannels )
+{
+    unsigned long n = numFrames;
+    if( n > m_numFrames - m_position ) n = m_numFrames - m_position;
+
+    unsigned long long s = m_position * m_numChannels;
+    if( numChannels == 1 && m_numChannels > 1 )
+    {
+        // mix down
+        float scale = 1.0f / m_numChannels;
+        for( unsigned long i = 0; i < n; i++ )
+        {
+            float sum = 0;
+            for( unsigned long c = 0; c < m_numChannels; c++ )
+                sum += sample( s++ );
+            dest[i] = sum * scale;
+        }
+    }
+    else
+    {
+        for( unsigned long i = 0; i < n; i++, s += m_numChannels )
+            for( unsigned long c = 0; c < numChannels; c++ )
+                dest[i * numChannels + c] =
+                    sample( s + (c < m_numChannels ? c : m_numChannels - 1) );
+    }
+
+    memset( dest + n * numChannels, 0, sizeof(float) * (numFrames - n) * numChannels );
+    m_position += n;
+    return n;
+}
@@ -0,0 +1,74 @@
+//-----------------------------------------------------------------------------
+// name: x-wavfile.h
+// desc: memory-mapped WAV file source
+//
+//   open() maps the whole file and finds the fmt and data chunks; read()
+//   converts straight from the mapping, so hours of audio cost no heap
+//   and no copies beyond the output block.  PCM 16/24/32-bit and 32-bit
+//   float, plain or WAVE_FORMAT_EXTENSIBLE, on a little-endian host.
+//-----------------------------------------------------------------------------
+#ifndef __MCD_X_WAVFILE_H__
+#define __MCD_X_WAVFILE_H__
+
+#include "x-source.h"
+#include <stddef.h>
+
+
+
+
+//-----------------------------------------------------------------------------
+// name: class XWavFile
+// desc: read-only WAV file as a sample source
+//-----------------------------------------------------------------------------
+class XWavFile : public XSource
+{
+public:
+    XWavFile();
+    virtual ~XWavFile();
+
+public:
+    // map and parse; false (file closed) if missing or unsupported
+    bool open( const char * path );
+    // unmap
+    void close();
+
+public:
+    // file channels map onto output channels one to one (extra output
+    // channels repeat the last file channel); a mono output gets the
+    // average of all file channels
+    virtual unsigned long read( float * dest, unsigned long numFrames,
+                                unsigned long numChannels );
+    virtual unsigned long sampleRate() const { return m_sampleRate; }
+    virtual unsigned long long length() const { return m_numFrames; }
+    virtual unsigned long long position() const { return m_position; }
+    // start over from frame n
+    void seek( unsigned long long n )
+    { m_position = n < m_numFrames ? n : m_numFrames; }
+    unsigned long numChannels() const { return m_numChannels; }
+
+private:
+    XWavFile( const XWavFile & );
+    XWavFile & operator =( const XWavFile & );
+
+    // sample s (interleaved index) as float in [-1, 1)
+    inline float sample( unsigned long long s ) const;
+
+private:
+    // whole file
+    void * m_map;
+    size_t m_mapSize;
+    // first sample of the data chunk
+    const unsigned char * m_data;
+    unsigned long m_sampleRate;
+    unsigned long m_numChannels;
+    // bytes per sample, and whether samples are float
+    unsigned long m_bytes;
+    bool m_float;
+    unsigned long long m_numFrames;
+    unsigned long long m_position;
+};
+
+
+
+
+#endif